@@ -0,0 +1,95 @@
+/*
+ * bounded_queue.h
+ *
+ *  Created on: Oct 15, 2026
+ *      Author: jjmccollum
+ */
+
+#ifndef BOUNDED_QUEUE_H_
+#define BOUNDED_QUEUE_H_
+
+#include <list>
+#include <utility>
+#include <mutex>
+#include <condition_variable>
+
+using namespace std;
+
+/**
+ * Thread-safe FIFO queue with a fixed capacity, shared by a number of producer threads and one or more consumer threads.
+ * Producers block while the queue is full, and the consumer blocks while it is empty, until every producer has finished.
+ * Items may also be given weights (e.g., their sizes in bytes); if a maximum total weight is set,
+ * then try_push() refuses any item that would take the queue over that weight, so that the producer can dispose of it some other way.
+ */
+template <typename T>
+class bounded_queue {
+private:
+	list<pair<T, size_t>> items;
+	size_t capacity;
+	size_t max_weight; //0 if the total weight of the items is not limited
+	size_t total_weight;
+	unsigned int num_producers;
+	mutex mtx;
+	condition_variable not_full;
+	condition_variable not_empty;
+public:
+	bounded_queue(size_t _capacity, unsigned int _num_producers, size_t _max_weight = 0) {
+		capacity = _capacity > 0 ? _capacity : 1;
+		max_weight = _max_weight;
+		total_weight = 0;
+		num_producers = _num_producers;
+	}
+	/**
+	 * Moves the given item onto the back of the queue, waiting for space if the queue is full.
+	 */
+	void push(T && item, size_t weight = 0) {
+		unique_lock<mutex> lock(mtx);
+		not_full.wait(lock, [&]() { return items.size() < capacity; });
+		total_weight += weight;
+		items.push_back(pair<T, size_t>(std::move(item), weight));
+		not_empty.notify_one();
+	}
+	/**
+	 * Moves the given item onto the back of the queue, waiting for space if the queue is full,
+	 * unless adding its weight would exceed the maximum total weight of the queue.
+	 * An item that is heavier than the maximum total weight by itself is therefore always refused.
+	 * The return value will be true if the item was added to the queue, and false (with the item left untouched) otherwise.
+	 */
+	bool try_push(T && item, size_t weight) {
+		unique_lock<mutex> lock(mtx);
+		not_full.wait(lock, [&]() { return items.size() < capacity; });
+		if (max_weight > 0 && total_weight + weight > max_weight) {
+			return false;
+		}
+		total_weight += weight;
+		items.push_back(pair<T, size_t>(std::move(item), weight));
+		not_empty.notify_one();
+		return true;
+	}
+	/**
+	 * Moves the item at the front of the queue into the given reference, waiting for an item if the queue is empty.
+	 * The return value will be false if the queue is empty and every producer has finished, and true otherwise.
+	 */
+	bool pop(T & item) {
+		unique_lock<mutex> lock(mtx);
+		not_empty.wait(lock, [&]() { return !items.empty() || num_producers == 0; });
+		if (items.empty()) {
+			return false;
+		}
+		item = std::move(items.front().first);
+		total_weight -= items.front().second;
+		items.pop_front();
+		not_full.notify_one();
+		return true;
+	}
+	/**
+	 * Signals that one of the producers will not push any more items.
+	 */
+	void producer_done() {
+		lock_guard<mutex> lock(mtx);
+		num_producers--;
+		not_empty.notify_all();
+	}
+};
+
+#endif /* BOUNDED_QUEUE_H_ */
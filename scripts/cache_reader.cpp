@@ -0,0 +1,955 @@
+/*
+ * cache_reader.cpp
+ *
+ *  Created on: Oct 15, 2026
+ *      Author: jjmccollum
+ */
+
+#include <iostream>
+#include <cstring>
+#include <string>
+#include <list>
+#include <vector>
+#include <set>
+#include <map>
+#include <utility>
+#include <unordered_map>
+#include <algorithm>
+#include <thread>
+#include <mutex>
+#include <functional>
+
+#include "roaring.hh"
+#include "sqlite3.h"
+#include "cache_reader.h"
+#include "comparison_views.h"
+#include "bounded_queue.h"
+
+using namespace std;
+using namespace roaring;
+
+/**
+ * Queries run by the cache reader, indexed by the constants below.
+ */
+enum cache_query {
+	SELECT_WITNESSES,
+	SELECT_VARIATION_UNIT_IDS,
+	SELECT_VARIATION_UNIT_LABELS,
+	SELECT_WITNESS_EXISTS,
+	SELECT_VARIATION_UNIT_EXISTS,
+	SELECT_READING_EXISTS,
+	SELECT_SELF_COMPARISONS,
+	SELECT_COMPARISONS_FOR_WITNESS,
+	SELECT_COMPARISON,
+	SELECT_ALL_COMPARISONS,
+	SELECT_VARIATION_UNIT,
+	SELECT_READINGS,
+	SELECT_READING_RELATIONS,
+	SELECT_READING_SUPPORT,
+	SELECT_COMPARISON_COUNTS_FOR_WITNESS,
+	SELECT_ALL_VARIATION_UNITS,
+	SELECT_ALL_READINGS,
+	SELECT_ALL_READING_RELATIONS,
+	SELECT_ALL_READING_SUPPORT,
+	SELECT_METADATA,
+	SELECT_VARIATION_UNIT_HASHES,
+	NUM_CACHE_QUERIES
+};
+
+/**
+ * Names of the bitmap columns of the GENEALOGICAL_COMPARISONS table, in the order of their flags.
+ */
+static const char * comparison_column_names[NUM_COMPARISON_BITMAPS] = {"EXTANT", "AGREEMENTS", "PRIOR", "POSTERIOR", "NOREL", "UNCLEAR", "EXPLAINED"};
+
+/**
+ * SQL for each query run by the cache reader, in the order of the constants above.
+ * The queries for genealogical comparisons name the columns they need explicitly, so that the columns read below are 0-indexed in this order:
+ * PRIMARY_WIT, SECONDARY_WIT, the seven bitmap columns, and COST (with ROW_ID before COST in the query that scans the whole table).
+ * The placeholder {bitmaps} stands for the bitmap columns, each of which is replaced with NULL when it is not needed.
+ */
+static const char * cache_query_sql[NUM_CACHE_QUERIES] = {
+	"SELECT WITNESS FROM WITNESSES ORDER BY ROW_ID",
+	"SELECT VARIATION_UNIT FROM VARIATION_UNITS ORDER BY ROW_ID",
+	"SELECT LABEL FROM VARIATION_UNITS ORDER BY ROW_ID",
+	"SELECT 1 FROM GENEALOGICAL_COMPARISONS WHERE PRIMARY_WIT=? LIMIT 1",
+	"SELECT 1 FROM VARIATION_UNITS WHERE VARIATION_UNIT=? LIMIT 1",
+	"SELECT 1 FROM READINGS WHERE VARIATION_UNIT=? AND READING=? LIMIT 1",
+	"SELECT PRIMARY_WIT, EXTANT FROM GENEALOGICAL_COMPARISONS WHERE PRIMARY_WIT=SECONDARY_WIT ORDER BY ROW_ID",
+	"SELECT PRIMARY_WIT, SECONDARY_WIT, {bitmaps}, COST FROM GENEALOGICAL_COMPARISONS WHERE PRIMARY_WIT=? ORDER BY ROW_ID",
+	"SELECT PRIMARY_WIT, SECONDARY_WIT, {bitmaps}, COST FROM GENEALOGICAL_COMPARISONS WHERE PRIMARY_WIT=? AND SECONDARY_WIT=?",
+	"SELECT PRIMARY_WIT, SECONDARY_WIT, {bitmaps}, ROW_ID, COST FROM GENEALOGICAL_COMPARISONS",
+	"SELECT LABEL, CONNECTIVITY FROM VARIATION_UNITS WHERE VARIATION_UNIT=?",
+	"SELECT READING FROM READINGS WHERE VARIATION_UNIT=? ORDER BY ROW_ID",
+	"SELECT PRIOR, POSTERIOR, WEIGHT FROM READING_RELATIONS WHERE VARIATION_UNIT=? ORDER BY ROW_ID",
+	"SELECT WITNESS, READING FROM READING_SUPPORT WHERE VARIATION_UNIT=? ORDER BY ROW_ID",
+	"SELECT PRIMARY_WIT, SECONDARY_WIT, EXTANT_COUNT, AGREEMENTS_COUNT, PRIOR_COUNT, POSTERIOR_COUNT, NOREL_COUNT, UNCLEAR_COUNT, EXPLAINED_COUNT, COST "
+		"FROM GENEALOGICAL_COMPARISONS WHERE PRIMARY_WIT=? ORDER BY ROW_ID",
+	"SELECT VARIATION_UNIT, LABEL, CONNECTIVITY FROM VARIATION_UNITS ORDER BY VARIATION_UNIT",
+	"SELECT VARIATION_UNIT, READING FROM READINGS ORDER BY VARIATION_UNIT, ROW_ID",
+	"SELECT VARIATION_UNIT, PRIOR, POSTERIOR, WEIGHT FROM READING_RELATIONS ORDER BY VARIATION_UNIT, ROW_ID",
+	"SELECT VARIATION_UNIT, WITNESS, READING FROM READING_SUPPORT ORDER BY VARIATION_UNIT",
+	"SELECT KEY, VALUE FROM METADATA ORDER BY KEY, VALUE",
+	"SELECT VARIATION_UNIT, LABEL, HASH FROM VARIATION_UNITS ORDER BY ROW_ID"
+};
+
+/**
+ * Deserializes the bitmap in the given column of the current row of the given statement.
+ */
+static Roaring read_bitmap_column(sqlite3_stmt * stmt, int col) {
+	int bytes = sqlite3_column_bytes(stmt, col);
+	const char * buf = reinterpret_cast<const char *>(sqlite3_column_blob(stmt, col));
+	return Roaring::readSafe(buf, bytes);
+}
+
+/**
+ * Returns pointers to the bitmaps of the given genealogical comparison, in the order of their column flags.
+ */
+static void get_comparison_bitmaps(genealogical_comparison & comp, Roaring * bitmaps[NUM_COMPARISON_BITMAPS]) {
+	bitmaps[0] = & comp.extant;
+	bitmaps[1] = & comp.agreements;
+	bitmaps[2] = & comp.prior;
+	bitmaps[3] = & comp.posterior;
+	bitmaps[4] = & comp.norel;
+	bitmaps[5] = & comp.unclear;
+	bitmaps[6] = & comp.explained;
+	return;
+}
+
+/**
+ * Returns the genealogical comparison in the current row of the given statement,
+ * whose columns must be in the order of the genealogical comparison queries above.
+ * Only the bitmaps of the given set of columns are decoded.
+ */
+static genealogical_comparison read_comparison_row(sqlite3_stmt * stmt, unsigned int columns) {
+	genealogical_comparison comp;
+	comp.primary_wit = string(reinterpret_cast<const char *>(sqlite3_column_text(stmt, 0)));
+	comp.secondary_wit = string(reinterpret_cast<const char *>(sqlite3_column_text(stmt, 1)));
+	Roaring * bitmaps[NUM_COMPARISON_BITMAPS];
+	get_comparison_bitmaps(comp, bitmaps);
+	for (unsigned int col = 0; col < NUM_COMPARISON_BITMAPS; col++) {
+		if (columns & (1 << col)) {
+			* bitmaps[col] = read_bitmap_column(stmt, col + 2);
+		}
+	}
+	comp.cost = float(sqlite3_column_double(stmt, 9));
+	return comp;
+}
+
+/**
+ * Default constructor, for a comparison with no bitmaps available.
+ */
+lazy_genealogical_comparison::lazy_genealogical_comparison() {
+	columns = 0;
+	decoded_columns = 0;
+	bitmap_data = vector<vector<char>>(NUM_COMPARISON_BITMAPS);
+	bitmaps = vector<Roaring>(NUM_COMPARISON_BITMAPS);
+	cost = 0;
+}
+
+/**
+ * Constructs a comparison of the given witnesses that is absent from the database,
+ * whose bitmaps in the given set of columns are available and empty.
+ */
+lazy_genealogical_comparison::lazy_genealogical_comparison(const string & _primary_wit, const string & _secondary_wit, unsigned int _columns) : lazy_genealogical_comparison() {
+	primary_wit = _primary_wit;
+	secondary_wit = _secondary_wit;
+	columns = _columns;
+	decoded_columns = _columns;
+}
+
+/**
+ * Constructs a comparison from the current row of the given statement, whose columns must be in the order of the genealogical comparison queries above,
+ * copying the serialized bitmaps of the given set of columns without decoding them.
+ */
+lazy_genealogical_comparison::lazy_genealogical_comparison(sqlite3_stmt * stmt, unsigned int _columns) : lazy_genealogical_comparison() {
+	primary_wit = string(reinterpret_cast<const char *>(sqlite3_column_text(stmt, 0)));
+	secondary_wit = string(reinterpret_cast<const char *>(sqlite3_column_text(stmt, 1)));
+	columns = _columns;
+	for (unsigned int col = 0; col < NUM_COMPARISON_BITMAPS; col++) {
+		if (columns & (1 << col)) {
+			int bytes = sqlite3_column_bytes(stmt, col + 2);
+			const char * buf = reinterpret_cast<const char *>(sqlite3_column_blob(stmt, col + 2));
+			bitmap_data[col] = vector<char>(buf, buf + bytes);
+		}
+	}
+	cost = float(sqlite3_column_double(stmt, 9));
+}
+
+/**
+ * Default destructor.
+ */
+lazy_genealogical_comparison::~lazy_genealogical_comparison() {
+}
+
+/**
+ * Returns the ID of the primary witness of this comparison.
+ */
+string lazy_genealogical_comparison::get_primary_wit() const {
+	return primary_wit;
+}
+
+/**
+ * Returns the ID of the secondary witness of this comparison.
+ */
+string lazy_genealogical_comparison::get_secondary_wit() const {
+	return secondary_wit;
+}
+
+/**
+ * Returns the set of bitmap columns read for this comparison.
+ */
+unsigned int lazy_genealogical_comparison::get_columns() const {
+	return columns;
+}
+
+/**
+ * Returns the genealogical cost of this comparison.
+ */
+float lazy_genealogical_comparison::get_cost() const {
+	return cost;
+}
+
+/**
+ * Returns the bitmap in the given column of this comparison, decoding it if this is the first time it has been accessed.
+ * Exits with an error if the column was not read from the database.
+ */
+const Roaring & lazy_genealogical_comparison::get_bitmap(comparison_column column) {
+	unsigned int col = 0;
+	while (col < NUM_COMPARISON_BITMAPS && (1u << col) != (unsigned int) column) {
+		col++;
+	}
+	if (col == NUM_COMPARISON_BITMAPS || !(columns & column)) {
+		cerr << "Error: the " << (col < NUM_COMPARISON_BITMAPS ? comparison_column_names[col] : "requested") << " bitmap of the genealogical comparison of witness " << primary_wit << " to witness " << secondary_wit << " was not read from the database." << endl;
+		exit(1);
+	}
+	if (!(decoded_columns & column)) {
+		bitmaps[col] = Roaring::readSafe(bitmap_data[col].data(), bitmap_data[col].size());
+		vector<char>().swap(bitmap_data[col]);
+		decoded_columns |= column;
+	}
+	return bitmaps[col];
+}
+
+/**
+ * Returns this comparison as a genealogical comparison of the core library, decoding the bitmaps of the given set of columns (and only those).
+ * Exits with an error if any of those columns was not read from the database.
+ */
+genealogical_comparison lazy_genealogical_comparison::get_genealogical_comparison(unsigned int _columns) {
+	genealogical_comparison comp;
+	comp.primary_wit = primary_wit;
+	comp.secondary_wit = secondary_wit;
+	Roaring * comp_bitmaps[NUM_COMPARISON_BITMAPS];
+	get_comparison_bitmaps(comp, comp_bitmaps);
+	for (unsigned int col = 0; col < NUM_COMPARISON_BITMAPS; col++) {
+		if (_columns & (1 << col)) {
+			* comp_bitmaps[col] = get_bitmap(comparison_column(1 << col));
+		}
+	}
+	comp.cost = cost;
+	return comp;
+}
+
+/**
+ * Adds the given string, followed by a terminating null character, to the given 64-bit FNV-1a hash.
+ */
+static void add_to_fingerprint(uint64_t & fingerprint, const string & s) {
+	for (size_t i = 0; i <= s.size(); i++) {
+		fingerprint ^= (uint64_t) (unsigned char) s.c_str()[i];
+		fingerprint *= 1099511628211ULL;
+	}
+	return;
+}
+
+/**
+ * Number of rows read by the scanning thread of the bulk witness loader before it hands them to a worker thread to decode.
+ */
+const size_t COMPARISON_ROW_BATCH_SIZE = 256;
+
+/**
+ * Undecoded row of the GENEALOGICAL_COMPARISONS table, copied out of SQLite by the scanning thread of the bulk witness loader.
+ */
+struct comparison_row {
+	sqlite3_int64 row_id;
+	unsigned int primary_wit_ind; //index of the primary witness in the witness list being loaded
+	string secondary_wit;
+	vector<char> bitmap_data; //serialized bitmaps, in column order and back to back
+	int bitmap_sizes[NUM_COMPARISON_BITMAPS];
+	float cost;
+};
+
+/**
+ * Decodes the given undecoded row of the GENEALOGICAL_COMPARISONS table into a genealogical comparison.
+ * Only the bitmaps of the given set of columns are decoded.
+ */
+static genealogical_comparison decode_comparison_row(const comparison_row & row, const string & primary_wit_id, unsigned int columns) {
+	genealogical_comparison comp;
+	comp.primary_wit = primary_wit_id;
+	comp.secondary_wit = row.secondary_wit;
+	Roaring * bitmaps[NUM_COMPARISON_BITMAPS];
+	get_comparison_bitmaps(comp, bitmaps);
+	size_t offset = 0;
+	for (unsigned int col = 0; col < NUM_COMPARISON_BITMAPS; col++) {
+		if (columns & (1 << col)) {
+			* bitmaps[col] = Roaring::readSafe(row.bitmap_data.data() + offset, row.bitmap_sizes[col]);
+		}
+		offset += row.bitmap_sizes[col];
+	}
+	comp.cost = row.cost;
+	return comp;
+}
+
+/**
+ * Default constructor, which leaves the reader without a connection until one is opened.
+ */
+cache_reader::cache_reader() {
+	db = NULL;
+	owns_db = false;
+	has_counts = -1;
+	statements = map<pair<unsigned int, unsigned int>, sqlite3_stmt *>();
+}
+
+/**
+ * Constructs a reader that borrows the given open connection.
+ * The connection will not be closed when the reader is, and no view of the genealogical comparisons is attached to it.
+ */
+cache_reader::cache_reader(sqlite3 * _db) {
+	db = _db;
+	owns_db = false;
+	has_counts = -1;
+	statements = map<pair<unsigned int, unsigned int>, sqlite3_stmt *>();
+}
+
+/**
+ * Default destructor, which finalizes all prepared statements and closes the connection if this reader owns it.
+ */
+cache_reader::~cache_reader() {
+	close();
+}
+
+/**
+ * Opens the genealogical cache database with the given name
+ * and, if it stores its genealogical comparisons in the compact or clustered schema, attaches a view that presents them in the full schema.
+ * The return value will be true if successful, and false (with the given error message set) otherwise.
+ */
+bool cache_reader::open(const string & db_name, string & error_msg) {
+	close();
+	int rc = sqlite3_open(db_name.c_str(), & db);
+	if (rc) {
+		error_msg = string(sqlite3_errmsg(db));
+		sqlite3_close(db);
+		db = NULL;
+		return false;
+	}
+	owns_db = true;
+	attach_comparisons_view(db);
+	return true;
+}
+
+/**
+ * Finalizes all prepared statements and closes the connection if this reader owns it.
+ */
+void cache_reader::close() {
+	for (pair<const pair<unsigned int, unsigned int>, sqlite3_stmt *> & kv : statements) {
+		sqlite3_finalize(kv.second);
+	}
+	statements.clear();
+	if (owns_db && db != NULL) {
+		sqlite3_close(db);
+	}
+	db = NULL;
+	owns_db = false;
+	has_counts = -1;
+	return;
+}
+
+/**
+ * Returns the prepared statement for the given query, reading the given set of bitmap columns if it is a query for genealogical comparisons,
+ * preparing it if this is the first time it is needed.
+ * The statement is prepared with sqlite3_prepare_v2 so that it is recompiled automatically if the database schema changes between calls.
+ * Exits with an error if the statement cannot be prepared.
+ */
+sqlite3_stmt * cache_reader::get_statement(unsigned int query, unsigned int columns) {
+	//Look up the statement before building its SQL, so that a statement that is already prepared costs only the lookup:
+	pair<unsigned int, unsigned int> key = pair<unsigned int, unsigned int>(query, columns);
+	map<pair<unsigned int, unsigned int>, sqlite3_stmt *>::iterator it = statements.find(key);
+	if (it != statements.end()) {
+		return it->second;
+	}
+	string sql = string(cache_query_sql[query]);
+	size_t bitmaps_pos = sql.find("{bitmaps}");
+	//A query without bitmap columns reads the same columns whatever set is given, so it is only prepared once, under the full set:
+	if (bitmaps_pos == string::npos && columns != ALL_COMPARISON_COLUMNS) {
+		return get_statement(query, ALL_COMPARISON_COLUMNS);
+	}
+	//Select NULL in place of any bitmap column that is not needed, so that it is neither read nor (in a view) computed:
+	if (bitmaps_pos != string::npos) {
+		string bitmaps_sql = string();
+		for (unsigned int col = 0; col < NUM_COMPARISON_BITMAPS; col++) {
+			bitmaps_sql += col > 0 ? ", " : "";
+			bitmaps_sql += (columns & (1 << col)) ? comparison_column_names[col] : "NULL";
+		}
+		sql.replace(bitmaps_pos, string("{bitmaps}").size(), bitmaps_sql);
+	}
+	sqlite3_stmt * stmt;
+	int rc = sqlite3_prepare_v2(db, sql.c_str(), -1, & stmt, 0);
+	if (rc != SQLITE_OK) {
+		cerr << "Error preparing statement " << sql << ": " << sqlite3_errmsg(db) << endl;
+		exit(1);
+	}
+	statements[key] = stmt;
+	return stmt;
+}
+
+/**
+ * Resets the given prepared statement and clears its bindings, so that it holds no locks and can be rebound on its next use.
+ */
+void cache_reader::release_statement(sqlite3_stmt * stmt) {
+	sqlite3_reset(stmt);
+	sqlite3_clear_bindings(stmt);
+	return;
+}
+
+/**
+ * Returns the IDs of the witnesses in the WITNESSES table, in order.
+ * Any witnesses whose IDs are in the set of excluded witness IDs will not be added to the witness list.
+ */
+list<string> cache_reader::get_list_wit(const set<string> & excluded_wit_ids) {
+	list<string> list_wit = list<string>();
+	int rc; //to store SQLite macros
+	sqlite3_stmt * stmt = get_statement(SELECT_WITNESSES);
+	rc = sqlite3_step(stmt);
+	while (rc == SQLITE_ROW) {
+		string wit_id = string(reinterpret_cast<const char *>(sqlite3_column_text(stmt, 0)));
+		//If the witness's ID is not in the excluded set, then add it:
+		if (excluded_wit_ids.find(wit_id) == excluded_wit_ids.end()) {
+			list_wit.push_back(wit_id);
+		}
+		rc = sqlite3_step(stmt);
+	}
+	release_statement(stmt);
+	return list_wit;
+}
+
+/**
+ * Returns the IDs of the variation units in the VARIATION_UNITS table, in order.
+ */
+vector<string> cache_reader::get_variation_unit_ids() {
+	vector<string> variation_unit_ids = vector<string>();
+	int rc; //to store SQLite macros
+	sqlite3_stmt * stmt = get_statement(SELECT_VARIATION_UNIT_IDS);
+	rc = sqlite3_step(stmt);
+	while (rc == SQLITE_ROW) {
+		variation_unit_ids.push_back(string(reinterpret_cast<const char *>(sqlite3_column_text(stmt, 0))));
+		rc = sqlite3_step(stmt);
+	}
+	release_statement(stmt);
+	return variation_unit_ids;
+}
+
+/**
+ * Returns the labels of the variation units in the VARIATION_UNITS table, in order.
+ */
+vector<string> cache_reader::get_variation_unit_labels() {
+	vector<string> variation_unit_labels = vector<string>();
+	int rc; //to store SQLite macros
+	sqlite3_stmt * stmt = get_statement(SELECT_VARIATION_UNIT_LABELS);
+	rc = sqlite3_step(stmt);
+	while (rc == SQLITE_ROW) {
+		variation_unit_labels.push_back(string(reinterpret_cast<const char *>(sqlite3_column_text(stmt, 0))));
+		rc = sqlite3_step(stmt);
+	}
+	release_statement(stmt);
+	return variation_unit_labels;
+}
+
+/**
+ * Returns a flag indicating whether the GENEALOGICAL_COMPARISONS table has any rows for the given primary witness ID.
+ */
+bool cache_reader::witness_exists(const string & wit_id) {
+	sqlite3_stmt * stmt = get_statement(SELECT_WITNESS_EXISTS);
+	sqlite3_bind_text(stmt, 1, wit_id.c_str(), -1, SQLITE_STATIC);
+	bool witness_exists = sqlite3_step(stmt) == SQLITE_ROW;
+	release_statement(stmt);
+	return witness_exists;
+}
+
+/**
+ * Returns a flag indicating whether the VARIATION_UNITS table has a row for the given variation unit ID.
+ */
+bool cache_reader::variation_unit_exists(const string & vu_id) {
+	sqlite3_stmt * stmt = get_statement(SELECT_VARIATION_UNIT_EXISTS);
+	sqlite3_bind_text(stmt, 1, vu_id.c_str(), -1, SQLITE_STATIC);
+	bool variation_unit_exists = sqlite3_step(stmt) == SQLITE_ROW;
+	release_statement(stmt);
+	return variation_unit_exists;
+}
+
+/**
+ * Returns a flag indicating whether the READINGS table has a row for the given reading ID at the given variation unit ID.
+ */
+bool cache_reader::reading_exists(const string & vu_id, const string & rdg) {
+	sqlite3_stmt * stmt = get_statement(SELECT_READING_EXISTS);
+	sqlite3_bind_text(stmt, 1, vu_id.c_str(), -1, SQLITE_STATIC);
+	sqlite3_bind_text(stmt, 2, rdg.c_str(), -1, SQLITE_STATIC);
+	bool reading_exists = sqlite3_step(stmt) == SQLITE_ROW;
+	release_statement(stmt);
+	return reading_exists;
+}
+
+/**
+ * Using the self-comparisons in the GENEALOGICAL_COMPARISONS table,
+ * adds the IDs of all witnesses extant at fewer than the given number of variation units to the given set of excluded witness IDs.
+ */
+void cache_reader::add_fragmentary_witnesses_to_excluded_set(const int min_extant, set<string> & excluded_wit_ids) {
+	int rc; //to store SQLite macros
+	sqlite3_stmt * stmt = get_statement(SELECT_SELF_COMPARISONS);
+	rc = sqlite3_step(stmt);
+	while (rc == SQLITE_ROW) {
+		string primary_wit_id = string(reinterpret_cast<const char *>(sqlite3_column_text(stmt, 0)));
+		Roaring extant = read_bitmap_column(stmt, 1);
+		if (extant.cardinality() < (uint64_t) min_extant) {
+			excluded_wit_ids.insert(primary_wit_id);
+		}
+		rc = sqlite3_step(stmt);
+	}
+	release_statement(stmt);
+	return;
+}
+
+/**
+ * Using the rows for the given witness ID in the GENEALOGICAL_COMPARISONS table, returns a witness.
+ * Any witnesses whose IDs are in the set of excluded witness IDs will not have their genealogical comparisons added to the witness being populated.
+ * Only the bitmaps of the given set of columns are read and decoded; the others are left empty (see comparison_column).
+ * They are decoded eagerly, since the witness class takes its comparisons already decoded.
+ */
+witness cache_reader::get_witness(const string & wit_id, const set<string> & excluded_wit_ids, unsigned int columns) {
+	int rc; //to store SQLite macros
+	//Populate this witness's list of genealogical comparisons to other witnesses:
+	list<genealogical_comparison> comps = list<genealogical_comparison>();
+	sqlite3_stmt * stmt = get_statement(SELECT_COMPARISONS_FOR_WITNESS, columns);
+	sqlite3_bind_text(stmt, 1, wit_id.c_str(), -1, SQLITE_STATIC);
+	rc = sqlite3_step(stmt);
+	while (rc == SQLITE_ROW) {
+		//If the secondary witness's ID is in the excluded set, then skip it without decoding its bitmaps:
+		string secondary_wit_id = string(reinterpret_cast<const char *>(sqlite3_column_text(stmt, 1)));
+		if (excluded_wit_ids.find(secondary_wit_id) == excluded_wit_ids.end()) {
+			comps.push_back(read_comparison_row(stmt, columns));
+		}
+		rc = sqlite3_step(stmt);
+	}
+	release_statement(stmt);
+	witness wit = witness(wit_id, comps);
+	return wit;
+}
+
+/**
+ * Returns true if the GENEALOGICAL_COMPARISONS table of the cache stores the number of variation units in each of its bitmaps,
+ * which caches populated before these counts were added do not.
+ * The result is checked once per connection.
+ */
+bool cache_reader::has_comparison_counts() {
+	if (has_counts < 0) {
+		sqlite3_stmt * stmt;
+		int rc = sqlite3_prepare_v2(db, "SELECT EXTANT_COUNT FROM GENEALOGICAL_COMPARISONS LIMIT 0", -1, & stmt, 0);
+		has_counts = rc == SQLITE_OK ? 1 : 0;
+		sqlite3_finalize(stmt);
+	}
+	return has_counts > 0;
+}
+
+/**
+ * Returns the relationship counts of the genealogical comparisons of the witness with the given ID to other witnesses, in the order of their rows,
+ * read from the count columns of the GENEALOGICAL_COMPARISONS table without reading or decoding any bitmaps.
+ * If the cache does not store the counts, then they are taken from the cardinalities of the decoded bitmaps instead.
+ * Any witnesses whose IDs are in the set of excluded witness IDs will not have their counts returned.
+ */
+list<comparison_counts> cache_reader::get_comparison_counts(const string & wit_id, const set<string> & excluded_wit_ids) {
+	int rc; //to store SQLite macros
+	list<comparison_counts> counts_list = list<comparison_counts>();
+	bool stored = has_comparison_counts();
+	sqlite3_stmt * stmt = stored ? get_statement(SELECT_COMPARISON_COUNTS_FOR_WITNESS) : get_statement(SELECT_COMPARISONS_FOR_WITNESS);
+	sqlite3_bind_text(stmt, 1, wit_id.c_str(), -1, SQLITE_STATIC);
+	rc = sqlite3_step(stmt);
+	while (rc == SQLITE_ROW) {
+		string secondary_wit_id = string(reinterpret_cast<const char *>(sqlite3_column_text(stmt, 1)));
+		if (excluded_wit_ids.find(secondary_wit_id) == excluded_wit_ids.end()) {
+			comparison_counts counts;
+			uint64_t * count_fields[NUM_COMPARISON_BITMAPS] = {& counts.extant, & counts.agreements, & counts.prior, & counts.posterior, & counts.norel, & counts.unclear, & counts.explained};
+			if (stored) {
+				counts.primary_wit = string(reinterpret_cast<const char *>(sqlite3_column_text(stmt, 0)));
+				counts.secondary_wit = secondary_wit_id;
+				for (unsigned int col = 0; col < NUM_COMPARISON_BITMAPS; col++) {
+					* count_fields[col] = uint64_t(sqlite3_column_int64(stmt, col + 2));
+				}
+				counts.cost = float(sqlite3_column_double(stmt, 9));
+			} else {
+				genealogical_comparison comp = read_comparison_row(stmt, ALL_COMPARISON_COLUMNS);
+				Roaring * bitmaps[NUM_COMPARISON_BITMAPS];
+				get_comparison_bitmaps(comp, bitmaps);
+				counts.primary_wit = comp.primary_wit;
+				counts.secondary_wit = comp.secondary_wit;
+				for (unsigned int col = 0; col < NUM_COMPARISON_BITMAPS; col++) {
+					* count_fields[col] = bitmaps[col]->cardinality();
+				}
+				counts.cost = comp.cost;
+			}
+			counts_list.push_back(counts);
+		}
+		rc = sqlite3_step(stmt);
+	}
+	release_statement(stmt);
+	return counts_list;
+}
+
+/**
+ * Returns a list of witnesses with the given IDs, in order, each populated with its genealogical comparisons to the other witnesses in the list.
+ * Rather than querying the GENEALOGICAL_COMPARISONS table once per witness, this reads the whole table in a single scan in storage order,
+ * skipping the rows of witnesses not in the list, and groups its rows by primary witness.
+ * The scan copies the serialized bitmaps of each row out of SQLite and hands them in batches to the given number of worker threads
+ * (or one per hardware thread, if 0 is given), which decode them while the scan continues;
+ * each witness's comparisons are then sorted by row ID, so they come out in the same order as from get_witness().
+ * Only the bitmaps of the given set of columns are read and decoded.
+ */
+list<witness> cache_reader::get_witnesses(const list<string> & list_wit, unsigned int num_threads, unsigned int columns) {
+	vector<string> wit_ids = vector<string>(list_wit.begin(), list_wit.end());
+	unordered_map<string, unsigned int> wit_inds = unordered_map<string, unsigned int>();
+	for (unsigned int wit_ind = 0; wit_ind < wit_ids.size(); wit_ind++) {
+		wit_inds[wit_ids[wit_ind]] = wit_ind;
+	}
+	if (num_threads == 0) {
+		num_threads = std::max(1u, thread::hardware_concurrency());
+	}
+	//Each witness's decoded comparisons, paired with their row IDs:
+	vector<vector<pair<sqlite3_int64, genealogical_comparison>>> comps_by_wit = vector<vector<pair<sqlite3_int64, genealogical_comparison>>>(wit_ids.size());
+	mutex comps_mtx;
+	//Start the worker threads, which decode batches of rows as the scan produces them:
+	bounded_queue<vector<comparison_row>> queue(2 * num_threads, 1);
+	vector<thread> workers;
+	for (unsigned int t = 0; t < num_threads; t++) {
+		workers.push_back(thread([&]() {
+			vector<comparison_row> batch;
+			while (queue.pop(batch)) {
+				vector<pair<sqlite3_int64, genealogical_comparison>> decoded = vector<pair<sqlite3_int64, genealogical_comparison>>();
+				decoded.reserve(batch.size());
+				for (const comparison_row & row : batch) {
+					decoded.push_back(pair<sqlite3_int64, genealogical_comparison>(row.row_id, decode_comparison_row(row, wit_ids[row.primary_wit_ind], columns)));
+				}
+				lock_guard<mutex> lock(comps_mtx);
+				for (unsigned int i = 0; i < batch.size(); i++) {
+					comps_by_wit[batch[i].primary_wit_ind].push_back(std::move(decoded[i]));
+				}
+			}
+		}));
+	}
+	//Then scan the table in this thread:
+	int rc; //to store SQLite macros
+	sqlite3_stmt * stmt = get_statement(SELECT_ALL_COMPARISONS, columns);
+	vector<comparison_row> batch = vector<comparison_row>();
+	batch.reserve(COMPARISON_ROW_BATCH_SIZE);
+	rc = sqlite3_step(stmt);
+	while (rc == SQLITE_ROW) {
+		//Skip any rows whose primary or secondary witness is not being loaded:
+		unordered_map<string, unsigned int>::const_iterator primary_it = wit_inds.find(string(reinterpret_cast<const char *>(sqlite3_column_text(stmt, 0))));
+		string secondary_wit_id = string(reinterpret_cast<const char *>(sqlite3_column_text(stmt, 1)));
+		if (primary_it == wit_inds.end() || wit_inds.find(secondary_wit_id) == wit_inds.end()) {
+			rc = sqlite3_step(stmt);
+			continue;
+		}
+		comparison_row row;
+		row.primary_wit_ind = primary_it->second;
+		row.secondary_wit = secondary_wit_id;
+		size_t total_bytes = 0;
+		for (unsigned int col = 0; col < NUM_COMPARISON_BITMAPS; col++) {
+			row.bitmap_sizes[col] = sqlite3_column_bytes(stmt, col + 2);
+			total_bytes += row.bitmap_sizes[col];
+		}
+		row.bitmap_data = vector<char>(total_bytes);
+		size_t offset = 0;
+		for (unsigned int col = 0; col < NUM_COMPARISON_BITMAPS; col++) {
+			if (row.bitmap_sizes[col] > 0) {
+				memcpy(row.bitmap_data.data() + offset, sqlite3_column_blob(stmt, col + 2), row.bitmap_sizes[col]);
+			}
+			offset += row.bitmap_sizes[col];
+		}
+		row.row_id = sqlite3_column_int64(stmt, 9);
+		row.cost = float(sqlite3_column_double(stmt, 10));
+		batch.push_back(std::move(row));
+		if (batch.size() == COMPARISON_ROW_BATCH_SIZE) {
+			queue.push(std::move(batch));
+			batch = vector<comparison_row>();
+			batch.reserve(COMPARISON_ROW_BATCH_SIZE);
+		}
+		rc = sqlite3_step(stmt);
+	}
+	release_statement(stmt);
+	if (!batch.empty()) {
+		queue.push(std::move(batch));
+	}
+	queue.producer_done();
+	for (thread & t : workers) {
+		t.join();
+	}
+	//Then put each witness's comparisons in row order and construct the witnesses:
+	list<witness> witnesses = list<witness>();
+	for (unsigned int wit_ind = 0; wit_ind < wit_ids.size(); wit_ind++) {
+		vector<pair<sqlite3_int64, genealogical_comparison>> & wit_comps = comps_by_wit[wit_ind];
+		sort(wit_comps.begin(), wit_comps.end(), [](const pair<sqlite3_int64, genealogical_comparison> & a, const pair<sqlite3_int64, genealogical_comparison> & b) {
+			return a.first < b.first;
+		});
+		list<genealogical_comparison> comps = list<genealogical_comparison>();
+		for (pair<sqlite3_int64, genealogical_comparison> & wit_comp : wit_comps) {
+			comps.push_back(std::move(wit_comp.second));
+		}
+		wit_comps = vector<pair<sqlite3_int64, genealogical_comparison>>();
+		witnesses.push_back(witness(wit_ids[wit_ind], comps));
+	}
+	return witnesses;
+}
+
+/**
+ * Using the row for the given primary and secondary witness IDs in the GENEALOGICAL_COMPARISONS table, returns a genealogical comparison.
+ * If there is no such row, then the returned comparison will be empty.
+ * Only the bitmaps of the given set of columns are read and decoded.
+ */
+genealogical_comparison cache_reader::get_genealogical_comparison(const string & primary_wit_id, const string & secondary_wit_id, unsigned int columns) {
+	genealogical_comparison comp = genealogical_comparison();
+	sqlite3_stmt * stmt = get_statement(SELECT_COMPARISON, columns);
+	sqlite3_bind_text(stmt, 1, primary_wit_id.c_str(), -1, SQLITE_STATIC);
+	sqlite3_bind_text(stmt, 2, secondary_wit_id.c_str(), -1, SQLITE_STATIC);
+	if (sqlite3_step(stmt) == SQLITE_ROW) {
+		comp = read_comparison_row(stmt, columns);
+	}
+	release_statement(stmt);
+	return comp;
+}
+
+/**
+ * Returns the comparison of the primary witness with the given ID to the secondary witness with the given ID,
+ * with the serialized bitmaps of the given set of columns copied out of the database, to be decoded only when they are first accessed.
+ * If the database has no such comparison, then the bitmaps of the given columns will be empty.
+ */
+lazy_genealogical_comparison cache_reader::get_lazy_genealogical_comparison(const string & primary_wit_id, const string & secondary_wit_id, unsigned int columns) {
+	lazy_genealogical_comparison comp = lazy_genealogical_comparison(primary_wit_id, secondary_wit_id, columns);
+	sqlite3_stmt * stmt = get_statement(SELECT_COMPARISON, columns);
+	sqlite3_bind_text(stmt, 1, primary_wit_id.c_str(), -1, SQLITE_STATIC);
+	sqlite3_bind_text(stmt, 2, secondary_wit_id.c_str(), -1, SQLITE_STATIC);
+	if (sqlite3_step(stmt) == SQLITE_ROW) {
+		comp = lazy_genealogical_comparison(stmt, columns);
+	}
+	release_statement(stmt);
+	return comp;
+}
+
+/**
+ * Returns the IDs of the readings of the variation unit with the given ID in the READINGS table, in order.
+ */
+list<string> cache_reader::get_readings(const string & vu_id) {
+	list<string> readings = list<string>();
+	int rc; //to store SQLite macros
+	sqlite3_stmt * stmt = get_statement(SELECT_READINGS);
+	sqlite3_bind_text(stmt, 1, vu_id.c_str(), -1, SQLITE_STATIC);
+	rc = sqlite3_step(stmt);
+	while (rc == SQLITE_ROW) {
+		readings.push_back(string(reinterpret_cast<const char *>(sqlite3_column_text(stmt, 0))));
+		rc = sqlite3_step(stmt);
+	}
+	release_statement(stmt);
+	return readings;
+}
+
+/**
+ * Returns the edges of the local stemma of the variation unit with the given ID in the READING_RELATIONS table, in order.
+ */
+list<local_stemma_edge> cache_reader::get_local_stemma_edges(const string & vu_id) {
+	list<local_stemma_edge> edges = list<local_stemma_edge>();
+	int rc; //to store SQLite macros
+	sqlite3_stmt * stmt = get_statement(SELECT_READING_RELATIONS);
+	sqlite3_bind_text(stmt, 1, vu_id.c_str(), -1, SQLITE_STATIC);
+	rc = sqlite3_step(stmt);
+	while (rc == SQLITE_ROW) {
+		local_stemma_edge e;
+		e.prior = string(reinterpret_cast<const char *>(sqlite3_column_text(stmt, 0)));
+		e.posterior = string(reinterpret_cast<const char *>(sqlite3_column_text(stmt, 1)));
+		e.weight = float(sqlite3_column_double(stmt, 2));
+		edges.push_back(e);
+		rc = sqlite3_step(stmt);
+	}
+	release_statement(stmt);
+	return edges;
+}
+
+/**
+ * Reconstructs the local stemma of the variation unit with the given ID and label from the READINGS and READING_RELATIONS tables.
+ */
+local_stemma cache_reader::get_local_stemma(const string & vu_id, const string & label) {
+	list<local_stemma_vertex> vertices = list<local_stemma_vertex>();
+	for (const string & rdg : get_readings(vu_id)) {
+		local_stemma_vertex v;
+		v.id = rdg;
+		vertices.push_back(v);
+	}
+	list<local_stemma_edge> edges = get_local_stemma_edges(vu_id);
+	return local_stemma(vu_id, label, vertices, edges);
+}
+
+/**
+ * Using the rows for the given variation unit ID in the VARIATION_UNITS, READINGS, READING_RELATIONS, and READING_SUPPORT tables,
+ * returns a variation unit.
+ */
+variation_unit cache_reader::get_variation_unit(const string & vu_id) {
+	int rc; //to store SQLite macros
+	//Retrieve the variation unit's label and connectivity limit:
+	string label = "";
+	int connectivity = 0;
+	sqlite3_stmt * select_from_variation_units_stmt = get_statement(SELECT_VARIATION_UNIT);
+	sqlite3_bind_text(select_from_variation_units_stmt, 1, vu_id.c_str(), -1, SQLITE_STATIC);
+	if (sqlite3_step(select_from_variation_units_stmt) == SQLITE_ROW) {
+		label = string(reinterpret_cast<const char *>(sqlite3_column_text(select_from_variation_units_stmt, 0)));
+		connectivity = int(sqlite3_column_int(select_from_variation_units_stmt, 1));
+	}
+	release_statement(select_from_variation_units_stmt);
+	//Populate a list of readings and a list of vertices for this unit's local stemma:
+	list<string> readings = get_readings(vu_id);
+	list<local_stemma_vertex> vertices = list<local_stemma_vertex>();
+	for (const string & rdg : readings) {
+		local_stemma_vertex v;
+		v.id = rdg;
+		vertices.push_back(v);
+	}
+	//Construct the local stemma for this unit:
+	list<local_stemma_edge> edges = get_local_stemma_edges(vu_id);
+	local_stemma ls = local_stemma(vu_id, label, vertices, edges);
+	//Construct the reading support map for this unit:
+	unordered_map<string, string> reading_support = unordered_map<string, string>();
+	sqlite3_stmt * select_from_reading_support_stmt = get_statement(SELECT_READING_SUPPORT);
+	sqlite3_bind_text(select_from_reading_support_stmt, 1, vu_id.c_str(), -1, SQLITE_STATIC);
+	rc = sqlite3_step(select_from_reading_support_stmt);
+	while (rc == SQLITE_ROW) {
+		string wit_id = string(reinterpret_cast<const char *>(sqlite3_column_text(select_from_reading_support_stmt, 0)));
+		string rdg = string(reinterpret_cast<const char *>(sqlite3_column_text(select_from_reading_support_stmt, 1)));
+		reading_support[wit_id] = rdg;
+		rc = sqlite3_step(select_from_reading_support_stmt);
+	}
+	release_statement(select_from_reading_support_stmt);
+	//Then construct this variation unit:
+	variation_unit vu = variation_unit(vu_id, label, readings, reading_support, connectivity, ls);
+	return vu;
+}
+
+/**
+ * Calls the given function on each variation unit in the VARIATION_UNITS table, in order,
+ * or only on those whose IDs are in the given filter set, if it is not empty.
+ * Rather than querying the four tables that describe a variation unit once per unit,
+ * this scans the VARIATION_UNITS, READINGS, READING_RELATIONS, and READING_SUPPORT tables once each, all ordered by variation unit ID,
+ * and merges their rows as it goes, so that only one variation unit is held in memory at a time.
+ * The units are therefore processed in order of their IDs rather than in collation order.
+ * Every table is indexed by variation unit ID first, so each scan follows its table's index instead of sorting the whole table;
+ * the readings and local stemma edges of each unit are still ordered by row ID, which only requires sorting the few rows of one unit at a time,
+ * while the reading support of a unit needs no order, so its scan is read from the index alone.
+ * If a filter set is given, then its units are looked up individually instead, since a few lookups are cheaper than four full scans.
+ */
+void cache_reader::for_each_variation_unit(const set<string> & filter_vu_ids, const function<void(variation_unit &)> & process) {
+	if (!filter_vu_ids.empty()) {
+		for (const string & vu_id : get_variation_unit_ids()) {
+			if (filter_vu_ids.find(vu_id) == filter_vu_ids.end()) {
+				continue;
+			}
+			variation_unit vu = get_variation_unit(vu_id);
+			process(vu);
+		}
+		return;
+	}
+	sqlite3_stmt * select_from_variation_units_stmt = get_statement(SELECT_ALL_VARIATION_UNITS);
+	sqlite3_stmt * select_from_readings_stmt = get_statement(SELECT_ALL_READINGS);
+	sqlite3_stmt * select_from_reading_relations_stmt = get_statement(SELECT_ALL_READING_RELATIONS);
+	sqlite3_stmt * select_from_reading_support_stmt = get_statement(SELECT_ALL_READING_SUPPORT);
+	//Step each of the other tables to its first row, so that the current row of each belongs to the next unit with rows in it:
+	int readings_rc = sqlite3_step(select_from_readings_stmt);
+	int reading_relations_rc = sqlite3_step(select_from_reading_relations_stmt);
+	int reading_support_rc = sqlite3_step(select_from_reading_support_stmt);
+	//Compares the variation unit ID in the first column of the current row of the given statement to the given ID,
+	//in the same order as SQLite's default BINARY collation:
+	auto compare_vu_id = [](sqlite3_stmt * stmt, const string & vu_id) {
+		return string(reinterpret_cast<const char *>(sqlite3_column_text(stmt, 0))).compare(vu_id);
+	};
+	while (sqlite3_step(select_from_variation_units_stmt) == SQLITE_ROW) {
+		string vu_id = string(reinterpret_cast<const char *>(sqlite3_column_text(select_from_variation_units_stmt, 0)));
+		string label = string(reinterpret_cast<const char *>(sqlite3_column_text(select_from_variation_units_stmt, 1)));
+		int connectivity = int(sqlite3_column_int(select_from_variation_units_stmt, 2));
+		//Skip any rows of the other tables for units that are not in the VARIATION_UNITS table, as the joins they replace would:
+		while (readings_rc == SQLITE_ROW && compare_vu_id(select_from_readings_stmt, vu_id) < 0) {
+			readings_rc = sqlite3_step(select_from_readings_stmt);
+		}
+		while (reading_relations_rc == SQLITE_ROW && compare_vu_id(select_from_reading_relations_stmt, vu_id) < 0) {
+			reading_relations_rc = sqlite3_step(select_from_reading_relations_stmt);
+		}
+		while (reading_support_rc == SQLITE_ROW && compare_vu_id(select_from_reading_support_stmt, vu_id) < 0) {
+			reading_support_rc = sqlite3_step(select_from_reading_support_stmt);
+		}
+		//Consume this unit's readings:
+		list<string> readings = list<string>();
+		list<local_stemma_vertex> vertices = list<local_stemma_vertex>();
+		while (readings_rc == SQLITE_ROW && compare_vu_id(select_from_readings_stmt, vu_id) == 0) {
+			string rdg = string(reinterpret_cast<const char *>(sqlite3_column_text(select_from_readings_stmt, 1)));
+			readings.push_back(rdg);
+			local_stemma_vertex v;
+			v.id = rdg;
+			vertices.push_back(v);
+			readings_rc = sqlite3_step(select_from_readings_stmt);
+		}
+		//Consume the edges of this unit's local stemma:
+		list<local_stemma_edge> edges = list<local_stemma_edge>();
+		while (reading_relations_rc == SQLITE_ROW && compare_vu_id(select_from_reading_relations_stmt, vu_id) == 0) {
+			local_stemma_edge e;
+			e.prior = string(reinterpret_cast<const char *>(sqlite3_column_text(select_from_reading_relations_stmt, 1)));
+			e.posterior = string(reinterpret_cast<const char *>(sqlite3_column_text(select_from_reading_relations_stmt, 2)));
+			e.weight = float(sqlite3_column_double(select_from_reading_relations_stmt, 3));
+			edges.push_back(e);
+			reading_relations_rc = sqlite3_step(select_from_reading_relations_stmt);
+		}
+		//Consume this unit's reading support:
+		unordered_map<string, string> reading_support = unordered_map<string, string>();
+		while (reading_support_rc == SQLITE_ROW && compare_vu_id(select_from_reading_support_stmt, vu_id) == 0) {
+			string wit_id = string(reinterpret_cast<const char *>(sqlite3_column_text(select_from_reading_support_stmt, 1)));
+			string rdg = string(reinterpret_cast<const char *>(sqlite3_column_text(select_from_reading_support_stmt, 2)));
+			reading_support[wit_id] = rdg;
+			reading_support_rc = sqlite3_step(select_from_reading_support_stmt);
+		}
+		//Then construct this variation unit and hand it off:
+		local_stemma ls = local_stemma(vu_id, label, vertices, edges);
+		variation_unit vu = variation_unit(vu_id, label, readings, reading_support, connectivity, ls);
+		process(vu);
+	}
+	release_statement(select_from_variation_units_stmt);
+	release_statement(select_from_readings_stmt);
+	release_statement(select_from_reading_relations_stmt);
+	release_statement(select_from_reading_support_stmt);
+	return;
+}
+
+/**
+ * Returns a fingerprint of the contents of the genealogical cache,
+ * computed as a 64-bit FNV-1a hash of the METADATA table, the witness list, and the IDs, labels, and hashes of the variation units.
+ * Since populate_db updates a unit's hash whenever its local stemma or reading support changes
+ * and increments the GENERATION entry of the METADATA table whenever it changes the cache in place,
+ * any change to the genealogical comparisons changes the fingerprint.
+ */
+uint64_t cache_reader::get_cache_fingerprint() {
+	uint64_t fingerprint = 14695981039346656037ULL;
+	int rc; //to store SQLite macros
+	for (unsigned int query : {SELECT_METADATA, SELECT_WITNESSES, SELECT_VARIATION_UNIT_HASHES}) {
+		sqlite3_stmt * stmt = get_statement(query);
+		rc = sqlite3_step(stmt);
+		while (rc == SQLITE_ROW) {
+			for (int col = 0; col < sqlite3_column_count(stmt); col++) {
+				const unsigned char * text = sqlite3_column_text(stmt, col);
+				add_to_fingerprint(fingerprint, text != NULL ? string(reinterpret_cast<const char *>(text)) : string());
+			}
+			rc = sqlite3_step(stmt);
+		}
+		release_statement(stmt);
+		//Separate the tables, so that rows cannot be shifted from one to another without changing the fingerprint:
+		add_to_fingerprint(fingerprint, string());
+	}
+	return fingerprint;
+}
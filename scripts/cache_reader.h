@@ -0,0 +1,138 @@
+/*
+ * cache_reader.h
+ *
+ *  Created on: Oct 15, 2026
+ *      Author: jjmccollum
+ */
+
+#ifndef CACHE_READER_H_
+#define CACHE_READER_H_
+
+#include <string>
+#include <list>
+#include <vector>
+#include <set>
+#include <map>
+#include <utility>
+#include <cstdint>
+#include <functional>
+
+#include "sqlite3.h"
+#include "witness.h"
+#include "variation_unit.h"
+#include "local_stemma.h"
+
+using namespace std;
+
+/**
+ * Flags for the bitmap columns of the GENEALOGICAL_COMPARISONS table, which can be combined to tell the cache reader which bitmaps a script needs.
+ * The bitmaps of any columns left out are neither read from the database nor decoded.
+ * A lazy_genealogical_comparison treats an access to one of these bitmaps as an error.
+ * The genealogical_comparison and witness classes of the core library have no way to mark a bitmap as unread, so the comparisons and witnesses
+ * returned with a set of columns hold empty bitmaps for the columns left out; they must only be read with the columns that their callers use.
+ */
+enum comparison_column {
+	EXTANT_COLUMN = 1 << 0,
+	AGREEMENTS_COLUMN = 1 << 1,
+	PRIOR_COLUMN = 1 << 2,
+	POSTERIOR_COLUMN = 1 << 3,
+	NOREL_COLUMN = 1 << 4,
+	UNCLEAR_COLUMN = 1 << 5,
+	EXPLAINED_COLUMN = 1 << 6,
+	ALL_COMPARISON_COLUMNS = (1 << 7) - 1
+};
+
+/**
+ * Number of bitmap columns in a row of the GENEALOGICAL_COMPARISONS table.
+ */
+const unsigned int NUM_COMPARISON_BITMAPS = 7;
+
+/**
+ * Genealogical comparison read from the GENEALOGICAL_COMPARISONS table whose bitmaps are copied out of the database in serialized form
+ * and are only decoded the first time they are accessed, so that bitmaps that are never used cost no deserialization.
+ * Only the bitmaps of the columns it was read with are available; accessing any other bitmap exits with an error instead of returning an empty bitmap.
+ */
+class lazy_genealogical_comparison {
+private:
+	string primary_wit;
+	string secondary_wit;
+	unsigned int columns; //set of bitmap columns read from the database
+	unsigned int decoded_columns; //set of bitmap columns decoded so far
+	vector<vector<char>> bitmap_data; //serialized bitmaps, indexed by column
+	vector<Roaring> bitmaps; //decoded bitmaps, indexed by column
+	float cost;
+public:
+	lazy_genealogical_comparison();
+	lazy_genealogical_comparison(const string & _primary_wit, const string & _secondary_wit, unsigned int _columns);
+	lazy_genealogical_comparison(sqlite3_stmt * stmt, unsigned int _columns);
+	virtual ~lazy_genealogical_comparison();
+	string get_primary_wit() const;
+	string get_secondary_wit() const;
+	unsigned int get_columns() const;
+	float get_cost() const;
+	const Roaring & get_bitmap(comparison_column column);
+	genealogical_comparison get_genealogical_comparison(unsigned int _columns);
+};
+
+/**
+ * The number of variation units in each relationship of a genealogical comparison, along with its genealogical cost,
+ * which is all that the compare_witnesses and find_relatives tables need of it.
+ */
+struct comparison_counts {
+	string primary_wit;
+	string secondary_wit;
+	uint64_t extant;
+	uint64_t agreements;
+	uint64_t prior;
+	uint64_t posterior;
+	uint64_t norel;
+	uint64_t unclear;
+	uint64_t explained;
+	float cost;
+};
+
+/**
+ * Reader for the tables of a genealogical cache database, shared by the scripts that query the cache.
+ * Each query is prepared once, the first time it is needed, and its statement is reset and rebound on every later call,
+ * so that loading many witnesses or variation units does not pay for parsing and planning the same SQL each time.
+ * A reader either opens and owns its own connection, through which the genealogical comparisons are presented in the full schema
+ * whatever schema the cache stores them in, or borrows a connection that is already open and that it will not close.
+ */
+class cache_reader {
+private:
+	sqlite3 * db;
+	bool owns_db;
+	int has_counts; //1 if the comparisons table has relationship count columns, 0 if not, and -1 if not yet checked
+	map<pair<unsigned int, unsigned int>, sqlite3_stmt *> statements; //prepared statements, keyed by query and set of bitmap columns read
+	sqlite3_stmt * get_statement(unsigned int query, unsigned int columns = ALL_COMPARISON_COLUMNS);
+	void release_statement(sqlite3_stmt * stmt);
+	list<string> get_readings(const string & vu_id);
+	list<local_stemma_edge> get_local_stemma_edges(const string & vu_id);
+public:
+	cache_reader();
+	cache_reader(sqlite3 * _db);
+	cache_reader(const cache_reader &) = delete;
+	cache_reader & operator=(const cache_reader &) = delete;
+	virtual ~cache_reader();
+	bool open(const string & db_name, string & error_msg);
+	void close();
+	list<string> get_list_wit(const set<string> & excluded_wit_ids = set<string>());
+	vector<string> get_variation_unit_ids();
+	vector<string> get_variation_unit_labels();
+	bool witness_exists(const string & wit_id);
+	bool variation_unit_exists(const string & vu_id);
+	bool reading_exists(const string & vu_id, const string & rdg);
+	void add_fragmentary_witnesses_to_excluded_set(const int min_extant, set<string> & excluded_wit_ids);
+	witness get_witness(const string & wit_id, const set<string> & excluded_wit_ids, unsigned int columns = ALL_COMPARISON_COLUMNS);
+	bool has_comparison_counts();
+	list<comparison_counts> get_comparison_counts(const string & wit_id, const set<string> & excluded_wit_ids);
+	list<witness> get_witnesses(const list<string> & list_wit, unsigned int num_threads = 0, unsigned int columns = ALL_COMPARISON_COLUMNS);
+	genealogical_comparison get_genealogical_comparison(const string & primary_wit_id, const string & secondary_wit_id, unsigned int columns = ALL_COMPARISON_COLUMNS);
+	lazy_genealogical_comparison get_lazy_genealogical_comparison(const string & primary_wit_id, const string & secondary_wit_id, unsigned int columns);
+	local_stemma get_local_stemma(const string & vu_id, const string & label);
+	variation_unit get_variation_unit(const string & vu_id);
+	uint64_t get_cache_fingerprint();
+	void for_each_variation_unit(const set<string> & filter_vu_ids, const function<void(variation_unit &)> & process);
+};
+
+#endif /* CACHE_READER_H_ */
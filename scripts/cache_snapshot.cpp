@@ -0,0 +1,534 @@
+/*
+ * cache_snapshot.cpp
+ *
+ *  Created on: Oct 15, 2026
+ *      Author: jjmccollum
+ */
+
+#ifdef _WIN32
+	#define NOMINMAX //to prevent windows.h from defining min and max macros
+	#include <windows.h> //for Windows file mapping support
+#else
+	#include <sys/mman.h> //for POSIX memory mapping support
+	#include <sys/stat.h>
+	#include <fcntl.h>
+	#include <unistd.h>
+#endif
+#include <iostream>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <list>
+#include <vector>
+#include <set>
+#include <unordered_map>
+
+#include "roaring.hh"
+#include "sqlite3.h"
+#include "witness.h"
+#include "cache_snapshot.h"
+#include "comparison_views.h"
+#include "cache_reader.h"
+
+using namespace std;
+using namespace roaring;
+
+/**
+ * Alignment in bytes required for frozen Roaring bitmaps.
+ */
+static const uint64_t FROZEN_ALIGNMENT = 32;
+
+/**
+ * Returns the given offset rounded up to a multiple of the given alignment.
+ */
+static inline uint64_t align_offset(uint64_t offset, uint64_t alignment) {
+	return (offset + alignment - 1) / alignment * alignment;
+}
+
+/**
+ * Moves the position of the given file to the given offset from the start of the file, exiting with an error if this fails.
+ */
+static void seek_snapshot(FILE * file, uint64_t offset) {
+	#ifdef _WIN32
+		int rc = _fseeki64(file, (long long) offset, SEEK_SET);
+	#else
+		int rc = fseeko(file, (off_t) offset, SEEK_SET);
+	#endif
+	if (rc != 0) {
+		cerr << "Error seeking in snapshot file." << endl;
+		exit(1);
+	}
+	return;
+}
+
+/**
+ * Writes the given number of bytes from the given buffer to the given file, exiting with an error if this fails.
+ */
+static void write_snapshot_bytes(FILE * file, const void * buf, size_t size) {
+	if (size > 0 && fwrite(buf, 1, size, file) != size) {
+		cerr << "Error writing snapshot file." << endl;
+		exit(1);
+	}
+	return;
+}
+
+/**
+ * Writes the given string to the given file as a 32-bit length followed by its characters.
+ */
+static void write_snapshot_string(FILE * file, const string & s) {
+	uint32_t length = (uint32_t) s.size();
+	write_snapshot_bytes(file, & length, sizeof(uint32_t));
+	write_snapshot_bytes(file, s.data(), s.size());
+	return;
+}
+
+/**
+ * Reads a string stored as a 32-bit length followed by its characters from the given position in the given buffer, and advances the position past it.
+ * The return value will be false if the string runs past the end of the buffer.
+ */
+static bool read_snapshot_string(const char * data, size_t size, uint64_t & pos, string & s) {
+	uint32_t length;
+	if (pos + sizeof(uint32_t) > size) {
+		return false;
+	}
+	memcpy(& length, data + pos, sizeof(uint32_t));
+	pos += sizeof(uint32_t);
+	if (pos + length > size) {
+		return false;
+	}
+	s = string(data + pos, length);
+	pos += length;
+	return true;
+}
+
+/**
+ * Prepares the given SQL statement on the given database, exiting with an error if this fails.
+ */
+static sqlite3_stmt * prepare_snapshot_statement(sqlite3 * input_db, const string & sql) {
+	sqlite3_stmt * stmt;
+	int rc = sqlite3_prepare_v2(input_db, sql.c_str(), -1, & stmt, 0);
+	if (rc != SQLITE_OK) {
+		cerr << "Error preparing statement " << sql << ": " << sqlite3_errmsg(input_db) << endl;
+		exit(1);
+	}
+	return stmt;
+}
+
+void write_cache_snapshot(sqlite3 * input_db, const string & snapshot_name) {
+	int rc; //to store SQLite macros
+	//Read the witness list, variation unit list, and rules from the database:
+	vector<string> list_wit = vector<string>();
+	unordered_map<string, uint32_t> wit_inds = unordered_map<string, uint32_t>();
+	sqlite3_stmt * select_from_witnesses_stmt = prepare_snapshot_statement(input_db, "SELECT WITNESS FROM WITNESSES ORDER BY ROW_ID");
+	rc = sqlite3_step(select_from_witnesses_stmt);
+	while (rc == SQLITE_ROW) {
+		string wit_id = string(reinterpret_cast<const char *>(sqlite3_column_text(select_from_witnesses_stmt, 0)));
+		wit_inds[wit_id] = (uint32_t) list_wit.size();
+		list_wit.push_back(wit_id);
+		rc = sqlite3_step(select_from_witnesses_stmt);
+	}
+	sqlite3_finalize(select_from_witnesses_stmt);
+	vector<string> unit_ids = vector<string>();
+	vector<string> unit_labels = vector<string>();
+	sqlite3_stmt * select_from_variation_units_stmt = prepare_snapshot_statement(input_db, "SELECT VARIATION_UNIT, LABEL FROM VARIATION_UNITS ORDER BY ROW_ID");
+	rc = sqlite3_step(select_from_variation_units_stmt);
+	while (rc == SQLITE_ROW) {
+		unit_ids.push_back(string(reinterpret_cast<const char *>(sqlite3_column_text(select_from_variation_units_stmt, 0))));
+		unit_labels.push_back(string(reinterpret_cast<const char *>(sqlite3_column_text(select_from_variation_units_stmt, 1))));
+		rc = sqlite3_step(select_from_variation_units_stmt);
+	}
+	sqlite3_finalize(select_from_variation_units_stmt);
+	uint32_t classic = 0;
+	sqlite3_stmt * select_from_metadata_stmt = prepare_snapshot_statement(input_db, "SELECT VALUE FROM METADATA WHERE KEY='CLASSIC'");
+	if (sqlite3_step(select_from_metadata_stmt) == SQLITE_ROW) {
+		classic = string(reinterpret_cast<const char *>(sqlite3_column_text(select_from_metadata_stmt, 0))) == "1" ? 1 : 0;
+	}
+	sqlite3_finalize(select_from_metadata_stmt);
+	cache_reader reader(input_db);
+	uint64_t cache_fingerprint = reader.get_cache_fingerprint();
+	reader.close();
+	//Then write the header and indices, leaving the comparison index zeroed until the comparisons are written:
+	FILE * file = fopen(snapshot_name.c_str(), "w+b");
+	if (file == NULL) {
+		cerr << "Error opening snapshot file " << snapshot_name << " for writing." << endl;
+		exit(1);
+	}
+	snapshot_header header;
+	memset(& header, 0, sizeof(header));
+	memcpy(header.magic, "CBGMSNAP", 8);
+	header.version = SNAPSHOT_VERSION;
+	header.byte_order_mark = 0x01020304;
+	header.classic = classic;
+	header.num_wits = (uint32_t) list_wit.size();
+	header.num_units = (uint32_t) unit_ids.size();
+	header.cache_fingerprint = cache_fingerprint;
+	header.witness_index_offset = sizeof(snapshot_header);
+	uint64_t offset = header.witness_index_offset;
+	for (const string & wit_id : list_wit) {
+		offset += sizeof(uint32_t) + wit_id.size();
+	}
+	header.unit_index_offset = offset;
+	for (size_t vu_ind = 0; vu_ind < unit_ids.size(); vu_ind++) {
+		offset += 2 * sizeof(uint32_t) + unit_ids[vu_ind].size() + unit_labels[vu_ind].size();
+	}
+	header.comparison_index_offset = align_offset(offset, 8);
+	uint64_t num_entries = (uint64_t) list_wit.size() * list_wit.size();
+	uint64_t data_offset = align_offset(header.comparison_index_offset + num_entries * sizeof(snapshot_comparison_entry), FROZEN_ALIGNMENT);
+	write_snapshot_bytes(file, & header, sizeof(header));
+	for (const string & wit_id : list_wit) {
+		write_snapshot_string(file, wit_id);
+	}
+	for (size_t vu_ind = 0; vu_ind < unit_ids.size(); vu_ind++) {
+		write_snapshot_string(file, unit_ids[vu_ind]);
+		write_snapshot_string(file, unit_labels[vu_ind]);
+	}
+	vector<char> zeros = vector<char>(1 << 16, 0);
+	for (uint64_t pos = offset; pos < data_offset; pos += zeros.size()) {
+		write_snapshot_bytes(file, zeros.data(), (size_t) std::min((uint64_t) zeros.size(), data_offset - pos));
+	}
+	//Then copy each comparison's bitmaps into the data section in the frozen format, which is written sequentially,
+	//and record where they were written in the comparison index.
+	//The comparisons are read one primary witness at a time, so that its row of the index can be filled in memory and written all at once:
+	vector<char> scratch = vector<char>();
+	vector<snapshot_comparison_entry> index_row = vector<snapshot_comparison_entry>(list_wit.size());
+	//If the cache uses the compact or clustered schema, then its comparisons are presented in the full schema by a view:
+	attach_comparisons_view(input_db);
+	sqlite3_stmt * select_from_genealogical_comparisons_stmt = prepare_snapshot_statement(input_db, "SELECT SECONDARY_WIT, EXTANT, AGREEMENTS, PRIOR, POSTERIOR, NOREL, UNCLEAR, EXPLAINED, COST FROM GENEALOGICAL_COMPARISONS WHERE PRIMARY_WIT=?");
+	for (uint32_t primary_wit_ind = 0; primary_wit_ind < (uint32_t) list_wit.size(); primary_wit_ind++) {
+		memset(index_row.data(), 0, index_row.size() * sizeof(snapshot_comparison_entry));
+		sqlite3_bind_text(select_from_genealogical_comparisons_stmt, 1, list_wit[primary_wit_ind].c_str(), -1, SQLITE_STATIC);
+		rc = sqlite3_step(select_from_genealogical_comparisons_stmt);
+		while (rc == SQLITE_ROW) {
+			string secondary_wit_id = string(reinterpret_cast<const char *>(sqlite3_column_text(select_from_genealogical_comparisons_stmt, 0)));
+			snapshot_comparison_entry & entry = index_row[wit_inds.at(secondary_wit_id)];
+			for (unsigned int i = 0; i < SNAPSHOT_NUM_BITMAPS; i++) {
+				int bytes = sqlite3_column_bytes(select_from_genealogical_comparisons_stmt, 1 + i);
+				const char * buf = reinterpret_cast<const char *>(sqlite3_column_blob(select_from_genealogical_comparisons_stmt, 1 + i));
+				Roaring bitmap = Roaring::readSafe(buf, bytes);
+				size_t frozen_size = bitmap.getFrozenSizeInBytes();
+				//The frozen format must be written to a buffer aligned in the same way as it will be read:
+				if (scratch.size() < frozen_size + FROZEN_ALIGNMENT) {
+					scratch.resize(frozen_size + FROZEN_ALIGNMENT);
+				}
+				char * aligned = scratch.data() + (FROZEN_ALIGNMENT - reinterpret_cast<uintptr_t>(scratch.data()) % FROZEN_ALIGNMENT) % FROZEN_ALIGNMENT;
+				bitmap.writeFrozen(aligned);
+				write_snapshot_bytes(file, aligned, frozen_size);
+				entry.offsets[i] = data_offset;
+				entry.sizes[i] = (uint32_t) frozen_size;
+				uint64_t next_offset = align_offset(data_offset + frozen_size, FROZEN_ALIGNMENT);
+				write_snapshot_bytes(file, zeros.data(), (size_t) (next_offset - data_offset - frozen_size));
+				data_offset = next_offset;
+			}
+			entry.cost = float(sqlite3_column_double(select_from_genealogical_comparisons_stmt, 8));
+			rc = sqlite3_step(select_from_genealogical_comparisons_stmt);
+		}
+		sqlite3_reset(select_from_genealogical_comparisons_stmt);
+		//Write this witness's row of the index, and then return to the end of the data section:
+		seek_snapshot(file, header.comparison_index_offset + (uint64_t) primary_wit_ind * list_wit.size() * sizeof(snapshot_comparison_entry));
+		write_snapshot_bytes(file, index_row.data(), index_row.size() * sizeof(snapshot_comparison_entry));
+		seek_snapshot(file, data_offset);
+	}
+	sqlite3_finalize(select_from_genealogical_comparisons_stmt);
+	//Finally, record the size of the file in the header, so that truncated snapshots can be detected:
+	header.file_size = data_offset;
+	seek_snapshot(file, 0);
+	write_snapshot_bytes(file, & header, sizeof(header));
+	if (fclose(file) != 0) {
+		cerr << "Error writing snapshot file " << snapshot_name << "." << endl;
+		exit(1);
+	}
+	return;
+}
+
+/**
+ * Default constructor.
+ */
+cache_snapshot::cache_snapshot() {
+	data = NULL;
+	size = 0;
+	file_handle = NULL;
+	mapping_handle = NULL;
+	classic = false;
+	cache_fingerprint = 0;
+	entries = NULL;
+}
+
+/**
+ * Default destructor.
+ */
+cache_snapshot::~cache_snapshot() {
+	unmap();
+}
+
+/**
+ * Unmaps the snapshot file, if it is mapped.
+ */
+void cache_snapshot::unmap() {
+	if (data == NULL) {
+		return;
+	}
+	#ifdef _WIN32
+		UnmapViewOfFile(data);
+		CloseHandle((HANDLE) mapping_handle);
+		CloseHandle((HANDLE) file_handle);
+	#else
+		munmap(const_cast<char *>(data), size);
+	#endif
+	data = NULL;
+	size = 0;
+	entries = NULL;
+	return;
+}
+
+/**
+ * Memory-maps the snapshot file with the given name and reads its header and indices.
+ * The return value will be true if successful, and false (with the given error message set) otherwise.
+ */
+bool cache_snapshot::open(const string & snapshot_name, string & error_msg) {
+	unmap();
+	#ifdef _WIN32
+		HANDLE file = CreateFileA(snapshot_name.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_RANDOM_ACCESS, NULL);
+		if (file == INVALID_HANDLE_VALUE) {
+			error_msg = "the file could not be opened";
+			return false;
+		}
+		LARGE_INTEGER file_size;
+		if (!GetFileSizeEx(file, & file_size) || file_size.QuadPart == 0) {
+			CloseHandle(file);
+			error_msg = "the file is empty";
+			return false;
+		}
+		HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+		if (mapping == NULL) {
+			CloseHandle(file);
+			error_msg = "the file could not be mapped";
+			return false;
+		}
+		data = reinterpret_cast<const char *>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+		if (data == NULL) {
+			CloseHandle(mapping);
+			CloseHandle(file);
+			error_msg = "the file could not be mapped";
+			return false;
+		}
+		file_handle = file;
+		mapping_handle = mapping;
+		size = (size_t) file_size.QuadPart;
+	#else
+		int fd = ::open(snapshot_name.c_str(), O_RDONLY);
+		if (fd < 0) {
+			error_msg = "the file could not be opened";
+			return false;
+		}
+		struct stat st;
+		if (fstat(fd, & st) != 0 || st.st_size == 0) {
+			close(fd);
+			error_msg = "the file is empty";
+			return false;
+		}
+		void * addr = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+		//The mapping remains valid after the file descriptor is closed:
+		close(fd);
+		if (addr == MAP_FAILED) {
+			error_msg = "the file could not be mapped";
+			return false;
+		}
+		data = reinterpret_cast<const char *>(addr);
+		size = (size_t) st.st_size;
+	#endif
+	//Check the header:
+	snapshot_header header;
+	if (size < sizeof(header)) {
+		unmap();
+		error_msg = "the file is too short to be a snapshot";
+		return false;
+	}
+	memcpy(& header, data, sizeof(header));
+	if (memcmp(header.magic, "CBGMSNAP", 8) != 0) {
+		unmap();
+		error_msg = "the file is not a snapshot";
+		return false;
+	}
+	if (header.version != SNAPSHOT_VERSION) {
+		unmap();
+		error_msg = "the snapshot has version " + to_string(header.version) + ", but version " + to_string(SNAPSHOT_VERSION) + " is required";
+		return false;
+	}
+	if (header.byte_order_mark != 0x01020304) {
+		unmap();
+		error_msg = "the snapshot was written on a machine with a different byte order";
+		return false;
+	}
+	uint64_t num_entries = (uint64_t) header.num_wits * header.num_wits;
+	if (header.file_size != size || header.comparison_index_offset % 8 != 0 || header.comparison_index_offset + num_entries * sizeof(snapshot_comparison_entry) > size) {
+		unmap();
+		error_msg = "the snapshot is truncated or corrupted";
+		return false;
+	}
+	classic = header.classic == 1;
+	cache_fingerprint = header.cache_fingerprint;
+	//Then read the witness and variation unit indices:
+	list_wit = vector<string>(header.num_wits);
+	uint64_t pos = header.witness_index_offset;
+	for (uint32_t i = 0; i < header.num_wits; i++) {
+		if (!read_snapshot_string(data, size, pos, list_wit[i])) {
+			unmap();
+			error_msg = "the snapshot's witness index is corrupted";
+			return false;
+		}
+	}
+	unit_ids = vector<string>(header.num_units);
+	unit_labels = vector<string>(header.num_units);
+	pos = header.unit_index_offset;
+	for (uint32_t i = 0; i < header.num_units; i++) {
+		if (!read_snapshot_string(data, size, pos, unit_ids[i]) || !read_snapshot_string(data, size, pos, unit_labels[i])) {
+			unmap();
+			error_msg = "the snapshot's variation unit index is corrupted";
+			return false;
+		}
+	}
+	entries = reinterpret_cast<const snapshot_comparison_entry *>(data + header.comparison_index_offset);
+	//Then check that every bitmap in the comparison index lies within the file at an offset aligned for a frozen view,
+	//so that a corrupted index cannot cause a view to be taken of memory outside of the mapping:
+	for (uint64_t entry_ind = 0; entry_ind < num_entries; entry_ind++) {
+		const snapshot_comparison_entry & entry = entries[entry_ind];
+		for (unsigned int i = 0; i < SNAPSHOT_NUM_BITMAPS; i++) {
+			if (entry.sizes[i] == 0) {
+				continue;
+			}
+			if (entry.offsets[i] % FROZEN_ALIGNMENT != 0 || entry.offsets[i] > size || entry.sizes[i] > size - entry.offsets[i]) {
+				unmap();
+				error_msg = "the snapshot's comparison index is corrupted";
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+/**
+ * Returns a flag indicating whether the cache in this snapshot was populated under classic rules.
+ */
+bool cache_snapshot::is_classic() const {
+	return classic;
+}
+
+/**
+ * Returns the fingerprint of the contents of the cache from which this snapshot was written.
+ */
+uint64_t cache_snapshot::get_cache_fingerprint() const {
+	return cache_fingerprint;
+}
+
+/**
+ * Returns the IDs of the witnesses in this snapshot, in the order of the cache's witness list.
+ */
+const vector<string> & cache_snapshot::get_list_wit() const {
+	return list_wit;
+}
+
+/**
+ * Returns the IDs of the variation units in this snapshot, in order.
+ */
+const vector<string> & cache_snapshot::get_unit_ids() const {
+	return unit_ids;
+}
+
+/**
+ * Returns the labels of the variation units in this snapshot, in order.
+ */
+const vector<string> & cache_snapshot::get_unit_labels() const {
+	return unit_labels;
+}
+
+/**
+ * Returns true if this snapshot contains a comparison of the primary witness at the given index to the secondary witness at the given index.
+ */
+bool cache_snapshot::has_comparison(unsigned int primary_wit_ind, unsigned int secondary_wit_ind) const {
+	const snapshot_comparison_entry & entry = entries[(size_t) primary_wit_ind * list_wit.size() + secondary_wit_ind];
+	return entry.sizes[0] != 0;
+}
+
+/**
+ * Returns a frozen view of the bitmap in the given column (see SNAPSHOT_NUM_BITMAPS) of the comparison
+ * of the primary witness at the given index to the secondary witness at the given index.
+ * The view refers directly to the mapped file, so it is only valid for the lifetime of this snapshot, and it cannot be modified.
+ */
+const Roaring cache_snapshot::get_bitmap_view(unsigned int primary_wit_ind, unsigned int secondary_wit_ind, unsigned int column) const {
+	const snapshot_comparison_entry & entry = entries[(size_t) primary_wit_ind * list_wit.size() + secondary_wit_ind];
+	return Roaring::frozenView(data + entry.offsets[column], entry.sizes[column]);
+}
+
+/**
+ * Returns the comparison of the primary witness at the given index to the secondary witness at the given index.
+ * Its bitmaps are copied out of frozen views of the mapped file into bitmaps that it owns;
+ * this copies their containers, but unlike reading them from the database, it does not deserialize them.
+ */
+genealogical_comparison cache_snapshot::get_comparison(unsigned int primary_wit_ind, unsigned int secondary_wit_ind) const {
+	const snapshot_comparison_entry & entry = entries[(size_t) primary_wit_ind * list_wit.size() + secondary_wit_ind];
+	genealogical_comparison comp;
+	comp.primary_wit = list_wit[primary_wit_ind];
+	comp.secondary_wit = list_wit[secondary_wit_ind];
+	Roaring * bitmaps[SNAPSHOT_NUM_BITMAPS] = {& comp.extant, & comp.agreements, & comp.prior, & comp.posterior, & comp.norel, & comp.unclear, & comp.explained};
+	for (unsigned int i = 0; i < SNAPSHOT_NUM_BITMAPS; i++) {
+		* bitmaps[i] = Roaring::frozenView(data + entry.offsets[i], entry.sizes[i]);
+	}
+	comp.cost = entry.cost;
+	return comp;
+}
+
+/**
+ * Using the self-comparisons in this snapshot,
+ * adds the IDs of all witnesses extant at fewer than the given number of variation units to the given set of excluded witness IDs.
+ * The extant bitmaps are viewed in place in the mapped file, so nothing is decoded or copied.
+ */
+void cache_snapshot::add_fragmentary_witnesses_to_excluded_set(const int min_extant, set<string> & excluded_wit_ids) const {
+	for (unsigned int wit_ind = 0; wit_ind < list_wit.size(); wit_ind++) {
+		if (!has_comparison(wit_ind, wit_ind)) {
+			continue;
+		}
+		const Roaring extant = get_bitmap_view(wit_ind, wit_ind, 0);
+		if (extant.cardinality() < min_extant) {
+			excluded_wit_ids.insert(list_wit[wit_ind]);
+		}
+	}
+	return;
+}
+
+/**
+ * Using the comparisons for the witness at the given index in this snapshot,
+ * returns a witness.
+ * The witness owns copies of the comparisons' bitmaps, so this copies every bitmap it uses out of the mapped file.
+ * Any witnesses whose IDs are in the set of excluded witness IDs will not have their genealogical comparisons added to the witness being populated.
+ */
+witness cache_snapshot::get_witness(unsigned int wit_ind, const set<string> & excluded_wit_ids) const {
+	list<genealogical_comparison> comps = list<genealogical_comparison>();
+	for (unsigned int secondary_wit_ind = 0; secondary_wit_ind < list_wit.size(); secondary_wit_ind++) {
+		//If the secondary witness's ID is in the excluded set, then skip it:
+		if (excluded_wit_ids.find(list_wit[secondary_wit_ind]) != excluded_wit_ids.end()) {
+			continue;
+		}
+		if (!has_comparison(wit_ind, secondary_wit_ind)) {
+			continue;
+		}
+		comps.push_back(get_comparison(wit_ind, secondary_wit_ind));
+	}
+	witness wit = witness(list_wit[wit_ind], comps);
+	return wit;
+}
+
+void open_snapshot(cache_reader & reader, const string & snapshot_name, cache_snapshot & snapshot) {
+	string error_msg = string();
+	if (!snapshot.open(snapshot_name, error_msg)) {
+		cerr << "Error opening snapshot " << snapshot_name << ": " << error_msg << "." << endl;
+		exit(1);
+	}
+	list<string> db_list_wit = reader.get_list_wit();
+	vector<string> db_vu_labels = reader.get_variation_unit_labels();
+	if (snapshot.get_cache_fingerprint() != reader.get_cache_fingerprint() || vector<string>(db_list_wit.begin(), db_list_wit.end()) != snapshot.get_list_wit() || db_vu_labels != snapshot.get_unit_labels()) {
+		cerr << "Error: the snapshot " << snapshot_name << " does not match the database; it may be out of date, in which case it should be rewritten with populate_db --snapshot." << endl;
+		exit(1);
+	}
+	return;
+}
@@ -0,0 +1,117 @@
+/*
+ * cache_snapshot.h
+ *
+ *  Created on: Oct 15, 2026
+ *      Author: jjmccollum
+ */
+
+#ifndef CACHE_SNAPSHOT_H_
+#define CACHE_SNAPSHOT_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <set>
+
+#include "roaring.hh"
+#include "sqlite3.h"
+#include "witness.h"
+#include "cache_reader.h"
+
+using namespace std;
+
+/**
+ * Version of the snapshot file layout; readers refuse snapshots with any other version.
+ */
+const uint32_t SNAPSHOT_VERSION = 2;
+
+/**
+ * Number of bitmap columns stored for each genealogical comparison, in the order of the GENEALOGICAL_COMPARISONS table:
+ * extant, agreements, prior, posterior, norel, unclear, and explained.
+ */
+const unsigned int SNAPSHOT_NUM_BITMAPS = 7;
+
+/**
+ * Header at the start of a snapshot file.
+ * All integers are stored in the byte order of the machine that wrote the snapshot, which is checked against the byte order mark.
+ * All offsets are measured from the start of the file.
+ */
+struct snapshot_header {
+	char magic[8]; //always "CBGMSNAP"
+	uint32_t version;
+	uint32_t byte_order_mark; //always 0x01020304
+	uint32_t classic; //1 if the cache was populated under classic rules, and 0 otherwise
+	uint32_t num_wits;
+	uint32_t num_units;
+	uint32_t reserved;
+	uint64_t witness_index_offset; //offset of the witness index: each witness ID as a 32-bit length followed by its characters, in witness list order
+	uint64_t unit_index_offset; //offset of the variation unit index: each unit's ID and label, stored as above, in variation unit order
+	uint64_t comparison_index_offset; //offset of the comparison index: one entry per ordered pair of witnesses, indexed by primary index * num_wits + secondary index
+	uint64_t file_size;
+	uint64_t cache_fingerprint; //fingerprint of the contents of the cache from which the snapshot was written (see cache_reader::get_cache_fingerprint())
+};
+
+/**
+ * Entry of the comparison index of a snapshot file.
+ * Each bitmap is stored in the frozen Roaring format at an offset aligned to 32 bytes, so that it can be viewed in place without being deserialized.
+ * An entry whose sizes are all 0 indicates a pair of witnesses with no comparison in the cache.
+ */
+struct snapshot_comparison_entry {
+	uint64_t offsets[SNAPSHOT_NUM_BITMAPS];
+	uint32_t sizes[SNAPSHOT_NUM_BITMAPS];
+	float cost;
+};
+
+/**
+ * Writes a snapshot of the witness list, variation unit list, and genealogical comparisons in the given genealogical cache database
+ * to the file with the given name.
+ * Exits with an error if the file cannot be written.
+ */
+void write_cache_snapshot(sqlite3 * input_db, const string & snapshot_name);
+
+/**
+ * Read-only view of a snapshot file, which is memory-mapped rather than read,
+ * so that opening a snapshot costs almost nothing and its bitmaps can be viewed in place as frozen Roaring views.
+ * Only get_bitmap_view() and add_fragmentary_witnesses_to_excluded_set() use the views directly;
+ * get_comparison() and get_witness() copy the bitmaps they return, since the comparisons and witnesses own their bitmaps.
+ */
+class cache_snapshot {
+private:
+	const char * data;
+	size_t size;
+	void * file_handle; //only used on Windows
+	void * mapping_handle; //only used on Windows
+	bool classic;
+	uint64_t cache_fingerprint;
+	vector<string> list_wit;
+	vector<string> unit_ids;
+	vector<string> unit_labels;
+	const snapshot_comparison_entry * entries;
+	void unmap();
+public:
+	cache_snapshot();
+	cache_snapshot(const cache_snapshot &) = delete;
+	cache_snapshot & operator=(const cache_snapshot &) = delete;
+	virtual ~cache_snapshot();
+	bool open(const string & snapshot_name, string & error_msg);
+	bool is_classic() const;
+	uint64_t get_cache_fingerprint() const;
+	const vector<string> & get_list_wit() const;
+	const vector<string> & get_unit_ids() const;
+	const vector<string> & get_unit_labels() const;
+	bool has_comparison(unsigned int primary_wit_ind, unsigned int secondary_wit_ind) const;
+	const Roaring get_bitmap_view(unsigned int primary_wit_ind, unsigned int secondary_wit_ind, unsigned int column) const;
+	genealogical_comparison get_comparison(unsigned int primary_wit_ind, unsigned int secondary_wit_ind) const;
+	void add_fragmentary_witnesses_to_excluded_set(const int min_extant, set<string> & excluded_wit_ids) const;
+	witness get_witness(unsigned int wit_ind, const set<string> & excluded_wit_ids) const;
+};
+
+/**
+ * Memory-maps the snapshot file with the given name into the given snapshot
+ * and checks that it was written from the current contents of the database open in the given cache reader,
+ * i.e., that its fingerprint and its witness and variation unit lists match those of the database.
+ * Exits with an error if the snapshot cannot be opened or is out of date.
+ */
+void open_snapshot(cache_reader & reader, const string & snapshot_name, cache_snapshot & snapshot);
+
+#endif /* CACHE_SNAPSHOT_H_ */
@@ -0,0 +1,322 @@
+/*
+ * comparison_counts_table.cpp
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: jjmccollum
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <cstdint>
+#include <string>
+#include <list>
+#include <vector>
+#include <set>
+#include <unordered_map>
+#include <algorithm>
+
+#include "variation_unit.h"
+#include "cache_reader.h"
+#include "comparison_counts_table.h"
+
+using namespace std;
+
+/**
+ * Default constructor.
+ */
+comparison_counts_table::comparison_counts_table() {
+	primary_extant = 0;
+	show_readings = false;
+}
+
+/**
+ * Constructs a compare_witnesses table from the relationship counts of the primary witness with the given ID,
+ * with a row for each witness in the given list other than the primary witness.
+ * If the given set of secondary witness IDs is not empty, then only the witnesses in it are included.
+ */
+comparison_counts_table::comparison_counts_table(const string & _primary_wit_id, const list<comparison_counts> & counts_list, const list<string> & list_wit, const set<string> & secondary_wit_ids) {
+	primary_wit_id = _primary_wit_id;
+	show_readings = false;
+	index_counts(counts_list);
+	for (const string & secondary_wit_id : list_wit) {
+		if (!secondary_wit_ids.empty() && secondary_wit_ids.find(secondary_wit_id) == secondary_wit_ids.end()) {
+			continue;
+		}
+		add_row(secondary_wit_id, "");
+	}
+	sort_rows();
+}
+
+/**
+ * Constructs a find_relatives table from the relationship counts of the primary witness with the given ID,
+ * with a row for each witness in the given list other than the primary witness, which lists that witness's reading at the given variation unit.
+ * If the given set of filter readings is not empty, then only the witnesses with one of those readings are included.
+ */
+comparison_counts_table::comparison_counts_table(const string & _primary_wit_id, const list<comparison_counts> & counts_list, const variation_unit & vu, const list<string> & list_wit, const set<string> & filter_readings) {
+	primary_wit_id = _primary_wit_id;
+	show_readings = true;
+	index_counts(counts_list);
+	unordered_map<string, string> reading_support = vu.get_reading_support();
+	for (const string & secondary_wit_id : list_wit) {
+		string rdg = reading_support.find(secondary_wit_id) != reading_support.end() ? reading_support.at(secondary_wit_id) : "-";
+		if (!filter_readings.empty() && filter_readings.find(rdg) == filter_readings.end()) {
+			continue;
+		}
+		add_row(secondary_wit_id, rdg);
+	}
+	sort_rows();
+}
+
+/**
+ * Default destructor.
+ */
+comparison_counts_table::~comparison_counts_table() {
+}
+
+/**
+ * Indexes the given relationship counts of the primary witness by secondary witness ID,
+ * reads the primary witness's number of extant variation units from its comparison to itself,
+ * and ranks its potential ancestors by their agreements with it.
+ */
+void comparison_counts_table::index_counts(const list<comparison_counts> & counts_list) {
+	primary_extant = 0;
+	counts_by_wit_id = unordered_map<string, comparison_counts>();
+	vector<const comparison_counts *> potential_ancestors = vector<const comparison_counts *>();
+	for (const comparison_counts & counts : counts_list) {
+		counts_by_wit_id[counts.secondary_wit] = counts;
+		if (counts.secondary_wit == primary_wit_id) {
+			primary_extant = counts.extant;
+		} else if (counts.posterior > counts.prior) {
+			potential_ancestors.push_back(& counts);
+		}
+	}
+	stable_sort(potential_ancestors.begin(), potential_ancestors.end(), [](const comparison_counts * a, const comparison_counts * b) {
+		return a->agreements > b->agreements;
+	});
+	nr_by_wit_id = unordered_map<string, int>();
+	int nr = 0;
+	uint64_t nr_agreements = 0;
+	for (const comparison_counts * counts : potential_ancestors) {
+		if (nr == 0 || counts->agreements < nr_agreements) {
+			nr++;
+			nr_agreements = counts->agreements;
+		}
+		nr_by_wit_id[counts->secondary_wit] = nr;
+	}
+	return;
+}
+
+/**
+ * Adds a row for the secondary witness with the given ID, with the given reading, to this table.
+ * Nothing is added for the primary witness or for a witness to which the primary witness has no comparison.
+ */
+void comparison_counts_table::add_row(const string & secondary_wit_id, const string & rdg) {
+	if (secondary_wit_id == primary_wit_id || counts_by_wit_id.find(secondary_wit_id) == counts_by_wit_id.end()) {
+		return;
+	}
+	const comparison_counts & counts = counts_by_wit_id.at(secondary_wit_id);
+	comparison_counts_table_row row;
+	row.id = secondary_wit_id;
+	row.dir = counts.posterior > counts.prior ? 1 : (counts.posterior < counts.prior ? -1 : 0);
+	row.nr = nr_by_wit_id.find(secondary_wit_id) != nr_by_wit_id.end() ? nr_by_wit_id.at(secondary_wit_id) : 0;
+	row.rdg = rdg;
+	row.pass = counts.extant;
+	row.eq = counts.agreements;
+	row.perc = counts.extant > 0 ? 100 * float(counts.agreements) / float(counts.extant) : 0;
+	row.prior = counts.prior;
+	row.posterior = counts.posterior;
+	row.norel = counts.norel;
+	row.uncl = counts.unclear;
+	row.expl = counts.explained;
+	row.cost = counts.cost;
+	rows.push_back(row);
+	return;
+}
+
+/**
+ * Sorts the rows of this table in descending order of agreements, keeping witnesses with equal agreements in witness list order.
+ */
+void comparison_counts_table::sort_rows() {
+	stable_sort(rows.begin(), rows.end(), [](const comparison_counts_table_row & a, const comparison_counts_table_row & b) {
+		return a.eq > b.eq;
+	});
+	return;
+}
+
+/**
+ * Returns the ID of the primary witness of this table.
+ */
+string comparison_counts_table::get_primary_wit_id() const {
+	return primary_wit_id;
+}
+
+/**
+ * Returns the number of variation units at which the primary witness of this table is extant.
+ */
+uint64_t comparison_counts_table::get_primary_extant() const {
+	return primary_extant;
+}
+
+/**
+ * Returns the rows of this table.
+ */
+vector<comparison_counts_table_row> comparison_counts_table::get_rows() const {
+	return rows;
+}
+
+/**
+ * Given an output stream, prints this table in fixed-width format.
+ */
+void comparison_counts_table::to_fixed_width(ostream & out) {
+	//Print the caption:
+	out << "Genealogical comparisons for W1 = " << primary_wit_id << " (" << primary_extant << " extant passages):";
+	out << "\n\n";
+	//Print the header row:
+	out << std::left << std::setw(8) << "W2";
+	out << std::left << std::setw(4) << "DIR";
+	out << std::right << std::setw(4) << "NR";
+	if (show_readings) {
+		out << std::setw(5) << "";
+		out << std::left << std::setw(8) << "RDG";
+	}
+	out << std::right << std::setw(9) << "PASS";
+	out << std::right << std::setw(9) << "EQ";
+	out << std::right << std::setw(12) << "";
+	out << std::right << std::setw(9) << "W1>W2";
+	out << std::right << std::setw(8) << "W1<W2";
+	out << std::right << std::setw(8) << "NOREL";
+	out << std::right << std::setw(8) << "UNCL";
+	out << std::right << std::setw(8) << "EXPL";
+	out << std::right << std::setw(12) << "COST";
+	out << "\n\n";
+	//Print the subsequent rows:
+	for (const comparison_counts_table_row & row : rows) {
+		out << std::left << std::setw(8) << row.id;
+		out << std::left << std::setw(4) << (row.dir == -1 ? "<" : (row.dir == 1 ? ">" : "="));
+		out << std::right << std::setw(4) << (row.nr > 0 ? to_string(row.nr) : "");
+		if (show_readings) {
+			out << std::setw(5) << "";
+			out << std::left << std::setw(8) << row.rdg;
+		}
+		out << std::right << std::setw(9) << row.pass;
+		out << std::right << std::setw(9) << row.eq;
+		out << std::right << std::setw(3) << "(" << std::right << std::setw(7) << std::fixed << std::setprecision(3) << row.perc << "%)";
+		out << std::right << std::setw(9) << row.prior;
+		out << std::right << std::setw(8) << row.posterior;
+		out << std::right << std::setw(8) << row.norel;
+		out << std::right << std::setw(8) << row.uncl;
+		out << std::right << std::setw(8) << row.expl;
+		if (row.nr > 0) {
+			out << std::right << std::setw(12) << std::fixed << std::setprecision(3) << row.cost;
+		}
+		out << "\n";
+	}
+	out << std::endl;
+	return;
+}
+
+/**
+ * Given an output stream and a delimiter, prints this table with its fields separated by the delimiter.
+ * The rank and cost fields are left empty for witnesses that are not potential ancestors of the primary witness.
+ */
+void comparison_counts_table::to_delimited(ostream & out, const string & delimiter) {
+	//Print the header row:
+	out << "W2" << delimiter;
+	out << "DIR" << delimiter;
+	out << "NR" << delimiter;
+	if (show_readings) {
+		out << "RDG" << delimiter;
+	}
+	out << "PASS" << delimiter;
+	out << "EQ" << delimiter;
+	out << "PERC" << delimiter;
+	out << "W1>W2" << delimiter;
+	out << "W1<W2" << delimiter;
+	out << "NOREL" << delimiter;
+	out << "UNCL" << delimiter;
+	out << "EXPL" << delimiter;
+	out << "COST" << "\n";
+	//Print the subsequent rows:
+	for (const comparison_counts_table_row & row : rows) {
+		out << row.id << delimiter;
+		out << (row.dir == -1 ? "<" : (row.dir == 1 ? ">" : "=")) << delimiter;
+		out << (row.nr > 0 ? to_string(row.nr) : "") << delimiter;
+		if (show_readings) {
+			out << row.rdg << delimiter;
+		}
+		out << row.pass << delimiter;
+		out << row.eq << delimiter;
+		out << std::fixed << std::setprecision(3) << row.perc << delimiter;
+		out << row.prior << delimiter;
+		out << row.posterior << delimiter;
+		out << row.norel << delimiter;
+		out << row.uncl << delimiter;
+		out << row.expl << delimiter;
+		if (row.nr > 0) {
+			out << std::fixed << std::setprecision(3) << row.cost;
+		}
+		out << "\n";
+	}
+	out << std::flush;
+	return;
+}
+
+/**
+ * Given an output stream, prints this table in comma-separated value (CSV) format.
+ */
+void comparison_counts_table::to_csv(ostream & out) {
+	to_delimited(out, ",");
+	return;
+}
+
+/**
+ * Given an output stream, prints this table in tab-separated value (TSV) format.
+ */
+void comparison_counts_table::to_tsv(ostream & out) {
+	to_delimited(out, "\t");
+	return;
+}
+
+/**
+ * Given an output stream, prints this table in JavaScript Object Notation (JSON) format.
+ * The rank and cost fields are null for witnesses that are not potential ancestors of the primary witness.
+ */
+void comparison_counts_table::to_json(ostream & out) {
+	out << "{";
+	out << "\"primary_wit\":" << "\"" << primary_wit_id << "\"" << ",";
+	out << "\"primary_extant\":" << primary_extant << ",";
+	out << "\"rows\":" << "[";
+	unsigned int row_num = 0;
+	for (const comparison_counts_table_row & row : rows) {
+		if (row_num > 0) {
+			out << ",";
+		}
+		out << "{";
+		out << "\"id\":" << "\"" << row.id << "\"" << ",";
+		out << "\"dir\":" << row.dir << ",";
+		out << "\"nr\":" << (row.nr > 0 ? to_string(row.nr) : "null") << ",";
+		if (show_readings) {
+			out << "\"rdg\":" << "\"" << row.rdg << "\"" << ",";
+		}
+		out << "\"pass\":" << row.pass << ",";
+		out << "\"eq\":" << row.eq << ",";
+		out << "\"perc\":" << std::fixed << std::setprecision(3) << row.perc << ",";
+		out << "\"prior\":" << row.prior << ",";
+		out << "\"posterior\":" << row.posterior << ",";
+		out << "\"norel\":" << row.norel << ",";
+		out << "\"uncl\":" << row.uncl << ",";
+		out << "\"expl\":" << row.expl << ",";
+		out << "\"cost\":";
+		if (row.nr > 0) {
+			out << std::fixed << std::setprecision(3) << row.cost;
+		} else {
+			out << "null";
+		}
+		out << "}";
+		row_num++;
+	}
+	out << "]";
+	out << "}";
+	out << std::endl;
+	return;
+}
@@ -0,0 +1,76 @@
+/*
+ * comparison_counts_table.h
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: jjmccollum
+ */
+
+#ifndef COMPARISON_COUNTS_TABLE_H_
+#define COMPARISON_COUNTS_TABLE_H_
+
+#include <cstdint>
+#include <string>
+#include <list>
+#include <vector>
+#include <set>
+#include <unordered_map>
+#include <iostream>
+
+#include "variation_unit.h"
+#include "cache_reader.h"
+
+using namespace std;
+
+/**
+ * Data structure representing a row of a comparison counts table.
+ */
+struct comparison_counts_table_row {
+	string id; //ID of the secondary witness
+	int dir; //1 if the secondary witness has the prior reading more often than the primary witness, -1 if less often, and 0 if equally often
+	int nr; //ancestral rank of the secondary witness if it is a potential ancestor of the primary witness, and 0 otherwise
+	string rdg; //reading of the secondary witness at the variation unit of a find_relatives table, or "-" if it is lacunose there
+	uint64_t pass; //number of variation units at which both witnesses are extant
+	uint64_t eq; //number of variation units at which both witnesses agree
+	float perc; //percentage of agreement at the variation units at which both witnesses are extant
+	uint64_t prior; //number of variation units at which the primary witness has the prior reading
+	uint64_t posterior; //number of variation units at which the primary witness has the posterior reading
+	uint64_t norel; //number of variation units at which the witnesses' readings have no directed relationship
+	uint64_t uncl; //number of variation units at which the witnesses' readings have an unclear relationship
+	uint64_t expl; //number of variation units at which the primary witness's reading is explained by the secondary witness's reading
+	float cost; //genealogical cost of the relationship, if the secondary witness is a potential ancestor of the primary witness
+};
+
+/**
+ * Table of the genealogical relationships of a primary witness to other witnesses, like those of the compare_witnesses and find_relatives scripts,
+ * built from the relationship counts of the primary witness's genealogical comparisons, so that no bitmaps are needed to populate it.
+ * The rows are sorted in descending order of agreements with the primary witness,
+ * and the potential ancestors of the primary witness (i.e., the witnesses with the prior reading more often than the primary witness)
+ * are ranked by their agreements with the primary witness, with ties sharing a rank.
+ */
+class comparison_counts_table {
+private:
+	string primary_wit_id;
+	uint64_t primary_extant;
+	bool show_readings;
+	unordered_map<string, comparison_counts> counts_by_wit_id;
+	unordered_map<string, int> nr_by_wit_id;
+	vector<comparison_counts_table_row> rows;
+	void index_counts(const list<comparison_counts> & counts_list);
+	void add_row(const string & secondary_wit_id, const string & rdg);
+	void sort_rows();
+	void to_delimited(ostream & out, const string & delimiter);
+public:
+	comparison_counts_table();
+	comparison_counts_table(const string & _primary_wit_id, const list<comparison_counts> & counts_list, const list<string> & list_wit, const set<string> & secondary_wit_ids);
+	comparison_counts_table(const string & _primary_wit_id, const list<comparison_counts> & counts_list, const variation_unit & vu, const list<string> & list_wit, const set<string> & filter_readings);
+	virtual ~comparison_counts_table();
+	string get_primary_wit_id() const;
+	uint64_t get_primary_extant() const;
+	vector<comparison_counts_table_row> get_rows() const;
+	void to_fixed_width(ostream & out);
+	void to_csv(ostream & out);
+	void to_tsv(ostream & out);
+	void to_json(ostream & out);
+};
+
+#endif /* COMPARISON_COUNTS_TABLE_H_ */
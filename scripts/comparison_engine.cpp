@@ -0,0 +1,517 @@
+/*
+ * comparison_engine.cpp
+ *
+ *  Created on: Oct 15, 2026
+ *      Author: jjmccollum
+ */
+
+#ifdef _MSC_VER
+	#include <intrin.h> //for _BitScanForward64
+#endif
+#include <cstdint>
+#include <algorithm>
+#include <string>
+#include <list>
+#include <vector>
+#include <set>
+#include <unordered_map>
+#include <utility>
+
+#include "roaring.hh"
+#include "apparatus.h"
+#include "variation_unit.h"
+#include "local_stemma.h"
+#include "witness.h"
+#include "comparison_engine.h"
+
+using namespace std;
+using namespace roaring;
+
+/**
+ * Returns the index of the lowest set bit in the given nonzero word.
+ */
+static inline unsigned int lowest_set_bit(uint64_t word) {
+	#ifdef _MSC_VER
+		unsigned long ind;
+		_BitScanForward64(& ind, word);
+		return (unsigned int) ind;
+	#else
+		return (unsigned int) __builtin_ctzll(word);
+	#endif
+}
+
+/**
+ * Adds the variation unit indices marked in the given word, whose lowest bit stands for the given unit index, to the given bitmap in a single insertion.
+ */
+static inline void add_word(Roaring & bitmap, uint64_t word, unsigned int first_vu_ind) {
+	if (word == 0) {
+		return;
+	}
+	uint32_t vu_inds[64];
+	size_t num_vu_inds = 0;
+	while (word != 0) {
+		vu_inds[num_vu_inds++] = first_vu_ind + lowest_set_bit(word);
+		word &= word - 1;
+	}
+	bitmap.addMany(num_vu_inds, vu_inds);
+	return;
+}
+
+/**
+ * Resets the given comparison to an empty comparison of the given primary witness to the given secondary witness.
+ */
+static void init_comparison(genealogical_comparison & comp, const string & primary_wit_id, const string & secondary_wit_id) {
+	comp.primary_wit = primary_wit_id;
+	comp.secondary_wit = secondary_wit_id;
+	comp.extant = Roaring();
+	comp.agreements = Roaring();
+	comp.prior = Roaring();
+	comp.posterior = Roaring();
+	comp.norel = Roaring();
+	comp.unclear = Roaring();
+	comp.explained = Roaring();
+	comp.cost = 0;
+	return;
+}
+
+/**
+ * Default constructor.
+ */
+comparison_engine::comparison_engine() {
+	num_unit_words = 0;
+	classic = false;
+}
+
+/**
+ * Constructs a comparison engine for the witnesses and variation units of the given apparatus.
+ * The classic flag indicates whether explained readings and costs should be calculated using classic CBGM rules.
+ * Each variation unit's reading support map is converted here into one column of the reading matrix and one bit of each extant witness's extant bitset,
+ * and its local stemma is copied once, so that neither has to be consulted per pair of witnesses.
+ */
+comparison_engine::comparison_engine(const apparatus & app, bool _classic) {
+	classic = _classic;
+	list<string> app_list_wit = app.get_list_wit();
+	list_wit = vector<string>(app_list_wit.begin(), app_list_wit.end());
+	vector<variation_unit> variation_units = app.get_variation_units();
+	size_t num_units = variation_units.size();
+	num_unit_words = (unsigned int) ((num_units + 63) / 64);
+	extant_bitsets = vector<uint64_t>(list_wit.size() * num_unit_words, 0);
+	unit_ids = vector<string>();
+	unit_ids.reserve(num_units);
+	reading_matrix = vector<int16_t>(list_wit.size() * num_units, -1);
+	unit_readings = vector<vector<string>>();
+	unit_readings.reserve(variation_units.size());
+	relation_tables = vector<vector<reading_relation>>();
+	relation_tables.reserve(variation_units.size());
+	extant_counts = vector<unsigned int>(list_wit.size(), 0);
+	for (const variation_unit & vu : variation_units) {
+		size_t vu_ind = unit_ids.size();
+		unit_ids.push_back(vu.get_id());
+		//Assign a code to each reading, starting with the unit's own reading list:
+		vector<string> readings = vector<string>();
+		unordered_map<string, unsigned int> reading_codes = unordered_map<string, unsigned int>();
+		for (const string & rdg : vu.get_readings()) {
+			if (reading_codes.find(rdg) == reading_codes.end()) {
+				reading_codes[rdg] = (unsigned int) readings.size();
+				readings.push_back(rdg);
+			}
+		}
+		//Then record the code of each extant witness's reading and mark the unit in the witness's extant bitset:
+		unordered_map<string, string> reading_support = vu.get_reading_support();
+		for (unsigned int wit_ind = 0; wit_ind < (unsigned int) list_wit.size(); wit_ind++) {
+			unordered_map<string, string>::const_iterator it = reading_support.find(list_wit[wit_ind]);
+			if (it == reading_support.end()) {
+				continue;
+			}
+			if (reading_codes.find(it->second) == reading_codes.end()) {
+				reading_codes[it->second] = (unsigned int) readings.size();
+				readings.push_back(it->second);
+			}
+			unsigned int rdg_code = reading_codes.at(it->second);
+			reading_matrix[wit_ind * num_units + vu_ind] = (int16_t) rdg_code;
+			extant_bitsets[wit_ind * num_unit_words + vu_ind / 64] |= uint64_t(1) << (vu_ind % 64);
+			extant_counts[wit_ind]++;
+		}
+		unit_readings.push_back(readings);
+		local_stemma ls = vu.get_local_stemma();
+		//Under classic rules, a reading can only be explained by a reading directly prior to it, so we record which readings are adjacent:
+		set<pair<string, string>> edges = set<pair<string, string>>();
+		for (const local_stemma_edge & e : ls.get_edges()) {
+			edges.insert(pair<string, string>(e.prior, e.posterior));
+		}
+		//Then relate every pair of readings at this unit:
+		vector<reading_relation> relation_table = vector<reading_relation>();
+		relation_table.reserve(readings.size() * readings.size());
+		for (const string & primary_rdg : readings) {
+			for (const string & secondary_rdg : readings) {
+				relation_table.push_back(relate_readings(ls, edges, primary_rdg, secondary_rdg));
+			}
+		}
+		relation_tables.push_back(relation_table);
+	}
+}
+
+/**
+ * Constructs a comparison engine for the witnesses at the given indices (in the given order) in the given engine's witness list,
+ * with the same variation units and rules.
+ * The engine's reading matrix rows and extant bitsets are copied for these witnesses,
+ * so this is much cheaper than constructing a new engine from the apparatus.
+ */
+comparison_engine::comparison_engine(const comparison_engine & engine, const vector<unsigned int> & wit_inds) {
+	classic = engine.classic;
+	size_t num_units = engine.unit_ids.size();
+	list_wit = vector<string>();
+	list_wit.reserve(wit_inds.size());
+	extant_counts = vector<unsigned int>();
+	extant_counts.reserve(wit_inds.size());
+	reading_matrix = vector<int16_t>();
+	reading_matrix.reserve(wit_inds.size() * num_units);
+	num_unit_words = engine.num_unit_words;
+	extant_bitsets = vector<uint64_t>();
+	extant_bitsets.reserve(wit_inds.size() * num_unit_words);
+	for (unsigned int wit_ind : wit_inds) {
+		list_wit.push_back(engine.list_wit[wit_ind]);
+		extant_counts.push_back(engine.extant_counts[wit_ind]);
+		vector<int16_t>::const_iterator row = engine.reading_matrix.begin() + wit_ind * num_units;
+		reading_matrix.insert(reading_matrix.end(), row, row + num_units);
+		vector<uint64_t>::const_iterator extant_row = engine.extant_bitsets.begin() + wit_ind * num_unit_words;
+		extant_bitsets.insert(extant_bitsets.end(), extant_row, extant_row + num_unit_words);
+	}
+	unit_ids = engine.unit_ids;
+	unit_readings = engine.unit_readings;
+	relation_tables = engine.relation_tables;
+}
+
+/**
+ * Default destructor.
+ */
+comparison_engine::~comparison_engine() {
+
+}
+
+/**
+ * Returns the code of the reading supported by the witness at the given index at the variation unit at the given index,
+ * or -1 if the witness is lacunose there.
+ */
+int comparison_engine::get_reading_code(unsigned int vu_ind, unsigned int wit_ind) const {
+	return reading_matrix[(size_t) wit_ind * unit_ids.size() + vu_ind];
+}
+
+/**
+ * Returns true if the witnesses at the given indices have the same reading at every variation unit
+ * (and are lacunose at the same variation units).
+ */
+bool comparison_engine::same_readings(unsigned int wit_ind_1, unsigned int wit_ind_2) const {
+	size_t num_units = unit_ids.size();
+	vector<int16_t>::const_iterator row_1 = reading_matrix.begin() + wit_ind_1 * num_units;
+	vector<int16_t>::const_iterator row_2 = reading_matrix.begin() + wit_ind_2 * num_units;
+	return equal(row_1, row_1 + num_units, row_2);
+}
+
+/**
+ * Returns the genealogical relationship of the given primary reading to the given secondary reading
+ * according to the given local stemma and its set of (prior, posterior) edges, under this engine's rules.
+ * This traverses the local stemma, so it is only called while the relation tables are being constructed.
+ */
+reading_relation comparison_engine::relate_readings(const local_stemma & ls, const set<pair<string, string>> & edges, const string & primary_rdg, const string & secondary_rdg) const {
+	reading_relation rel;
+	rel.type = UNCLEAR;
+	rel.explained = false;
+	rel.mirrored_explained = false;
+	rel.cost = 0;
+	rel.mirrored_cost = 0;
+	//If the readings agree, then each explains the other:
+	if (primary_rdg == secondary_rdg) {
+		rel.type = AGREE;
+		rel.explained = true;
+		rel.mirrored_explained = true;
+		return rel;
+	}
+	//If the primary reading is prior, then it explains the secondary reading:
+	if (ls.path_exists(primary_rdg, secondary_rdg)) {
+		rel.type = PRIOR;
+		if (!classic) {
+			rel.mirrored_explained = true;
+			rel.mirrored_cost = ls.get_path(primary_rdg, secondary_rdg).weight;
+		}
+		else {
+			rel.mirrored_explained = edges.find(pair<string, string>(primary_rdg, secondary_rdg)) != edges.end();
+		}
+	}
+	//If the secondary reading is prior, then it explains the primary reading:
+	else if (ls.path_exists(secondary_rdg, primary_rdg)) {
+		rel.type = POSTERIOR;
+		if (!classic) {
+			rel.explained = true;
+			rel.cost = ls.get_path(secondary_rdg, primary_rdg).weight;
+		}
+		else {
+			rel.explained = edges.find(pair<string, string>(secondary_rdg, primary_rdg)) != edges.end();
+		}
+	}
+	//Otherwise, the readings are either independent or have an unclear relationship:
+	else if (ls.common_ancestor_exists(primary_rdg, secondary_rdg)) {
+		rel.type = NOREL;
+	}
+	return rel;
+}
+
+/**
+ * Returns the genealogical relationship of the reading with the given primary code to the reading with the given secondary code
+ * at the variation unit with the given index, as recorded in the unit's relation table.
+ */
+const reading_relation & comparison_engine::get_relation(unsigned int vu_ind, int primary_rdg_code, int secondary_rdg_code) const {
+	return relation_tables[vu_ind][primary_rdg_code * unit_readings[vu_ind].size() + secondary_rdg_code];
+}
+
+/**
+ * Accumulates the given comparison of the primary witness at the first given index to the secondary witness at the second given index,
+ * along with its mirrored comparison, 64 variation units at a time.
+ * For each word of units, the units where both witnesses are extant are the AND of the words of their extant bitsets,
+ * and the units where they agree are found by comparing the witnesses' rows of the reading matrix across the word's units, a loop that compilers vectorize;
+ * the resulting masks are then added to the comparisons' bitmaps a whole word at a time.
+ * Agreements are explained in both directions and cost nothing, so only the units where the witnesses disagree have their relationships looked up.
+ * The bitmaps shared by both directions are only updated in the first comparison; see finalize_pair().
+ * The costs of both comparisons are accumulated here (in the order of the units), although they are replaced under classic rules.
+ */
+void comparison_engine::accumulate_pair(unsigned int primary_wit_ind, unsigned int secondary_wit_ind, genealogical_comparison & comp, genealogical_comparison & mirrored_comp) const {
+	size_t num_units = unit_ids.size();
+	const uint64_t * primary_extant = extant_bitsets.data() + (size_t) primary_wit_ind * num_unit_words;
+	const uint64_t * secondary_extant = extant_bitsets.data() + (size_t) secondary_wit_ind * num_unit_words;
+	const int16_t * primary_row = reading_matrix.data() + (size_t) primary_wit_ind * num_units;
+	const int16_t * secondary_row = reading_matrix.data() + (size_t) secondary_wit_ind * num_units;
+	for (unsigned int word_ind = 0; word_ind < num_unit_words; word_ind++) {
+		uint64_t extant_word = primary_extant[word_ind] & secondary_extant[word_ind];
+		if (extant_word == 0) {
+			continue;
+		}
+		unsigned int first_vu_ind = word_ind * 64;
+		unsigned int num_word_units = (unsigned int) min(size_t(64), num_units - first_vu_ind);
+		uint64_t same_word = 0;
+		for (unsigned int i = 0; i < num_word_units; i++) {
+			same_word |= uint64_t(primary_row[first_vu_ind + i] == secondary_row[first_vu_ind + i]) << i;
+		}
+		uint64_t agreements_word = extant_word & same_word;
+		uint64_t prior_word = 0;
+		uint64_t posterior_word = 0;
+		uint64_t norel_word = 0;
+		uint64_t unclear_word = 0;
+		uint64_t explained_word = agreements_word;
+		uint64_t mirrored_explained_word = agreements_word;
+		uint64_t disagreements_word = extant_word & ~same_word;
+		while (disagreements_word != 0) {
+			unsigned int bit = lowest_set_bit(disagreements_word);
+			disagreements_word &= disagreements_word - 1;
+			uint64_t mask = uint64_t(1) << bit;
+			unsigned int vu_ind = first_vu_ind + bit;
+			const reading_relation & rel = get_relation(vu_ind, primary_row[vu_ind], secondary_row[vu_ind]);
+			switch (rel.type) {
+				case PRIOR:
+					prior_word |= mask;
+					break;
+				case POSTERIOR:
+					posterior_word |= mask;
+					break;
+				case NOREL:
+					norel_word |= mask;
+					break;
+				case UNCLEAR:
+					unclear_word |= mask;
+					break;
+				default:
+					break;
+			}
+			if (rel.explained) {
+				explained_word |= mask;
+			}
+			if (rel.mirrored_explained) {
+				mirrored_explained_word |= mask;
+			}
+			comp.cost += rel.cost;
+			mirrored_comp.cost += rel.mirrored_cost;
+		}
+		add_word(comp.extant, extant_word, first_vu_ind);
+		add_word(comp.agreements, agreements_word, first_vu_ind);
+		add_word(comp.prior, prior_word, first_vu_ind);
+		add_word(comp.posterior, posterior_word, first_vu_ind);
+		add_word(comp.norel, norel_word, first_vu_ind);
+		add_word(comp.unclear, unclear_word, first_vu_ind);
+		add_word(comp.explained, explained_word, first_vu_ind);
+		add_word(mirrored_comp.explained, mirrored_explained_word, first_vu_ind);
+	}
+	return;
+}
+
+/**
+ * Completes the given comparison and its mirrored comparison once all variation units have been applied to them
+ * by copying the shared bitmaps into the mirrored comparison and swapping its prior and posterior bitmaps.
+ * Under classic rules, the cost in both directions is the number of passages where the witnesses are known to disagree.
+ */
+void comparison_engine::finalize_pair(genealogical_comparison & comp, genealogical_comparison & mirrored_comp) const {
+	if (classic) {
+		comp.cost = float(comp.extant.cardinality() - comp.agreements.cardinality());
+		mirrored_comp.cost = comp.cost;
+	}
+	mirrored_comp.extant = comp.extant;
+	mirrored_comp.agreements = comp.agreements;
+	mirrored_comp.prior = comp.posterior;
+	mirrored_comp.posterior = comp.prior;
+	mirrored_comp.norel = comp.norel;
+	mirrored_comp.unclear = comp.unclear;
+	return;
+}
+
+/**
+ * Returns the IDs of the witnesses compared by this engine, in the order of the apparatus's witness list.
+ */
+vector<string> comparison_engine::get_list_wit() const {
+	return list_wit;
+}
+
+/**
+ * Returns a flag indicating whether this engine uses classic CBGM rules for explained readings and costs.
+ */
+bool comparison_engine::is_classic() const {
+	return classic;
+}
+
+/**
+ * Returns the number of variation units at which each witness is extant, indexed by the witness's position in the witness list.
+ */
+vector<unsigned int> comparison_engine::get_extant_counts() const {
+	return extant_counts;
+}
+
+/**
+ * Returns the number of variation units compared by this engine.
+ */
+unsigned int comparison_engine::get_num_units() const {
+	return (unsigned int) unit_ids.size();
+}
+
+/**
+ * Returns the ID of the variation unit at the given index.
+ */
+const string & comparison_engine::get_unit_id(unsigned int vu_ind) const {
+	return unit_ids[vu_ind];
+}
+
+/**
+ * Returns the IDs of the readings at the variation unit at the given index, indexed by reading code.
+ */
+const vector<string> & comparison_engine::get_unit_readings(unsigned int vu_ind) const {
+	return unit_readings[vu_ind];
+}
+
+/**
+ * Sets the given string to the reading supported by the witness at the given index at the variation unit at the given index.
+ * Returns false (leaving the string unchanged) if the witness is lacunose there.
+ */
+bool comparison_engine::get_reading(unsigned int vu_ind, unsigned int wit_ind, string & rdg) const {
+	int rdg_code = get_reading_code(vu_ind, wit_ind);
+	if (rdg_code < 0) {
+		return false;
+	}
+	rdg = unit_readings[vu_ind][rdg_code];
+	return true;
+}
+
+/**
+ * Sets the given relation to the genealogical relationship of the reading of the primary witness at the given index
+ * to the reading of the secondary witness at the given index at the variation unit with the given index.
+ * Returns false (leaving the relation unchanged) if either witness is lacunose there.
+ */
+bool comparison_engine::relate_witnesses(unsigned int vu_ind, unsigned int primary_wit_ind, unsigned int secondary_wit_ind, reading_relation & rel) const {
+	int primary_rdg_code = get_reading_code(vu_ind, primary_wit_ind);
+	int secondary_rdg_code = get_reading_code(vu_ind, secondary_wit_ind);
+	if (primary_rdg_code < 0 || secondary_rdg_code < 0) {
+		return false;
+	}
+	rel = get_relation(vu_ind, primary_rdg_code, secondary_rdg_code);
+	return true;
+}
+
+/**
+ * Returns the cost of the genealogical comparison of the primary witness at the given index to the secondary witness at the given index.
+ * The costs of the variation units are summed in the same order as in compare_from(),
+ * so that the result is exactly the cost of a freshly calculated comparison, rounding included.
+ */
+float comparison_engine::get_cost(unsigned int primary_wit_ind, unsigned int secondary_wit_ind) const {
+	float cost = 0;
+	unsigned int num_disagreements = 0;
+	for (unsigned int vu_ind = 0; vu_ind < (unsigned int) unit_ids.size(); vu_ind++) {
+		int primary_rdg_code = get_reading_code(vu_ind, primary_wit_ind);
+		int secondary_rdg_code = get_reading_code(vu_ind, secondary_wit_ind);
+		if (primary_rdg_code < 0 || secondary_rdg_code < 0) {
+			continue;
+		}
+		const reading_relation & rel = get_relation(vu_ind, primary_rdg_code, secondary_rdg_code);
+		if (rel.type != AGREE) {
+			num_disagreements++;
+		}
+		cost += rel.cost;
+	}
+	//Under classic rules, the cost is the number of passages where the witnesses are known to disagree (see finalize_pair()):
+	return classic ? float(num_disagreements) : cost;
+}
+
+/**
+ * Returns the genealogical comparison of the witness at the given index with itself.
+ * The witness agrees with itself, and thereby explains its own reading, at every passage where it is extant.
+ */
+genealogical_comparison comparison_engine::compare_self(unsigned int wit_ind) const {
+	genealogical_comparison comp;
+	init_comparison(comp, list_wit[wit_ind], list_wit[wit_ind]);
+	const uint64_t * extant = extant_bitsets.data() + (size_t) wit_ind * num_unit_words;
+	for (unsigned int word_ind = 0; word_ind < num_unit_words; word_ind++) {
+		add_word(comp.extant, extant[word_ind], word_ind * 64);
+	}
+	comp.agreements = comp.extant;
+	comp.explained = comp.extant;
+	return comp;
+}
+
+/**
+ * Populates the genealogical comparison of the primary witness at the first given index to the secondary witness at the second given index,
+ * along with the mirrored comparison of the secondary witness to the primary witness, in a single pass over the variation units.
+ */
+void comparison_engine::compare_pair(unsigned int primary_wit_ind, unsigned int secondary_wit_ind, genealogical_comparison & comp, genealogical_comparison & mirrored_comp) const {
+	init_comparison(comp, list_wit[primary_wit_ind], list_wit[secondary_wit_ind]);
+	init_comparison(mirrored_comp, list_wit[secondary_wit_ind], list_wit[primary_wit_ind]);
+	accumulate_pair(primary_wit_ind, secondary_wit_ind, comp, mirrored_comp);
+	finalize_pair(comp, mirrored_comp);
+	return;
+}
+
+/**
+ * Returns the genealogical comparisons of the witness at the given index with itself and with every witness after it in the witness list,
+ * in both directions.
+ * Calling this method for every witness index therefore produces every ordered pair of witnesses exactly once.
+ */
+list<genealogical_comparison> comparison_engine::compare_from(unsigned int primary_wit_ind) const {
+	return compare_from(primary_wit_ind, primary_wit_ind, (unsigned int) list_wit.size());
+}
+
+/**
+ * Returns the genealogical comparisons of the witness at the given index with the witnesses whose indices fall in the given half-open range, in both directions.
+ * The range must not start before the primary witness; if it starts at the primary witness, then the comparison of the primary witness with itself is included.
+ * This allows the comparisons of one primary witness to be split across several tasks.
+ * Each pair of witnesses is accumulated a word of variation units at a time; see accumulate_pair().
+ */
+list<genealogical_comparison> comparison_engine::compare_from(unsigned int primary_wit_ind, unsigned int begin_wit_ind, unsigned int end_wit_ind) const {
+	bool include_self = begin_wit_ind == primary_wit_ind;
+	//Only witnesses after the primary witness are compared pairwise:
+	unsigned int first_wit_ind = include_self ? primary_wit_ind + 1 : begin_wit_ind;
+	list<genealogical_comparison> result = list<genealogical_comparison>();
+	if (include_self) {
+		result.push_back(compare_self(primary_wit_ind));
+	}
+	for (unsigned int secondary_wit_ind = first_wit_ind; secondary_wit_ind < end_wit_ind; secondary_wit_ind++) {
+		genealogical_comparison comp;
+		genealogical_comparison mirrored_comp;
+		compare_pair(primary_wit_ind, secondary_wit_ind, comp, mirrored_comp);
+		result.push_back(std::move(comp));
+		result.push_back(std::move(mirrored_comp));
+	}
+	return result;
+}
@@ -0,0 +1,93 @@
+/*
+ * comparison_engine.h
+ *
+ *  Created on: Oct 15, 2026
+ *      Author: jjmccollum
+ */
+
+#ifndef COMPARISON_ENGINE_H_
+#define COMPARISON_ENGINE_H_
+
+#include <cstdint>
+#include <string>
+#include <list>
+#include <vector>
+#include <set>
+#include <utility>
+
+#include "roaring.hh"
+#include "apparatus.h"
+#include "variation_unit.h"
+#include "local_stemma.h"
+#include "witness.h"
+
+using namespace std;
+
+/**
+ * Types of genealogical relationships between two witnesses' readings at a variation unit.
+ */
+enum relationship_type { AGREE, PRIOR, POSTERIOR, NOREL, UNCLEAR };
+
+/**
+ * Genealogical relationship of a primary witness's reading to a secondary witness's reading at a variation unit,
+ * along with its consequences for the comparisons in both directions.
+ */
+struct reading_relation {
+	relationship_type type;
+	bool explained; //whether the primary reading is explained by the secondary reading
+	bool mirrored_explained; //whether the secondary reading is explained by the primary reading
+	float cost; //cost of deriving the primary reading from the secondary reading
+	float mirrored_cost; //cost of deriving the secondary reading from the primary reading
+};
+
+/**
+ * Computes the genealogical comparisons between all pairs of witnesses in an apparatus.
+ * Each unordered pair of witnesses is evaluated only once:
+ * the extant, agreements, norel, and unclear bitmaps are shared by both directions of the pair,
+ * the prior and posterior bitmaps are swapped, and the explained bitmaps and costs of both directions are accumulated in the same pass.
+ * For each witness, the engine stores a bitset over variation unit indices marking the units at which the witness is extant,
+ * so that the units where two witnesses are both extant, and those where they agree, are accumulated 64 units at a time with word-wise operations
+ * instead of one unit at a time; only the units where they disagree have their relationships looked up.
+ * Witnesses and readings are interned as integers: each witness is identified by its index in the witness list,
+ * and each reading by its code at its variation unit, and a dense witness-by-unit matrix of reading codes gives any witness's reading in constant time.
+ * The genealogical relationship of every pair of readings at each variation unit is worked out from the unit's local stemma once, when the engine is constructed,
+ * so that relating two witnesses' readings is a table lookup rather than a traversal of the local stemma.
+ */
+class comparison_engine {
+private:
+	vector<string> list_wit;
+	unsigned int num_unit_words; //number of 64-bit words in each witness's extant bitset
+	vector<string> unit_ids; //ID of each variation unit
+	vector<vector<string>> unit_readings; //reading IDs at each variation unit, indexed by reading code
+	vector<int16_t> reading_matrix; //code of the reading of each witness at each variation unit (stored by witness, then unit), or -1 where the witness is lacunose
+	vector<uint64_t> extant_bitsets; //for each witness, the bitset of variation units at which it is extant (stored by witness, then word)
+	vector<vector<reading_relation>> relation_tables; //for each variation unit, the relation of each reading to each reading, indexed by primary code * number of readings + secondary code
+	vector<unsigned int> extant_counts; //number of variation units at which each witness is extant
+	bool classic;
+	reading_relation relate_readings(const local_stemma & ls, const set<pair<string, string>> & edges, const string & primary_rdg, const string & secondary_rdg) const;
+	const reading_relation & get_relation(unsigned int vu_ind, int primary_rdg_code, int secondary_rdg_code) const;
+	void accumulate_pair(unsigned int primary_wit_ind, unsigned int secondary_wit_ind, genealogical_comparison & comp, genealogical_comparison & mirrored_comp) const;
+	void finalize_pair(genealogical_comparison & comp, genealogical_comparison & mirrored_comp) const;
+public:
+	comparison_engine();
+	comparison_engine(const apparatus & app, bool _classic);
+	comparison_engine(const comparison_engine & engine, const vector<unsigned int> & wit_inds);
+	virtual ~comparison_engine();
+	vector<string> get_list_wit() const;
+	bool is_classic() const;
+	vector<unsigned int> get_extant_counts() const;
+	unsigned int get_num_units() const;
+	const string & get_unit_id(unsigned int vu_ind) const;
+	const vector<string> & get_unit_readings(unsigned int vu_ind) const;
+	int get_reading_code(unsigned int vu_ind, unsigned int wit_ind) const;
+	bool same_readings(unsigned int wit_ind_1, unsigned int wit_ind_2) const;
+	bool get_reading(unsigned int vu_ind, unsigned int wit_ind, string & rdg) const;
+	bool relate_witnesses(unsigned int vu_ind, unsigned int primary_wit_ind, unsigned int secondary_wit_ind, reading_relation & rel) const;
+	float get_cost(unsigned int primary_wit_ind, unsigned int secondary_wit_ind) const;
+	genealogical_comparison compare_self(unsigned int wit_ind) const;
+	void compare_pair(unsigned int primary_wit_ind, unsigned int secondary_wit_ind, genealogical_comparison & comp, genealogical_comparison & mirrored_comp) const;
+	list<genealogical_comparison> compare_from(unsigned int primary_wit_ind) const;
+	list<genealogical_comparison> compare_from(unsigned int primary_wit_ind, unsigned int begin_wit_ind, unsigned int end_wit_ind) const;
+};
+
+#endif /* COMPARISON_ENGINE_H_ */
@@ -0,0 +1,176 @@
+/*
+ * comparison_views.cpp
+ *
+ *  Created on: Oct 15, 2026
+ *      Author: jjmccollum
+ */
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "roaring.hh"
+#include "sqlite3.h"
+#include "comparison_views.h"
+
+using namespace std;
+using namespace roaring;
+
+/**
+ * Implementation of the ROARING_ANDNOT SQL function,
+ * which returns the serialized bitmap containing the values of its first serialized bitmap argument that are in none of the others.
+ * In the compact schema, the NOREL bitmap of a comparison is the EXTANT bitmap minus the AGREEMENTS, PRIOR, POSTERIOR, and UNCLEAR bitmaps,
+ * since these five bitmaps partition the units at which both witnesses are extant.
+ */
+static void roaring_andnot(sqlite3_context * context, int argc, sqlite3_value ** argv) {
+	int bytes = sqlite3_value_bytes(argv[0]);
+	const char * buf = reinterpret_cast<const char *>(sqlite3_value_blob(argv[0]));
+	Roaring result = Roaring::readSafe(buf, bytes);
+	for (int i = 1; i < argc; i++) {
+		bytes = sqlite3_value_bytes(argv[i]);
+		buf = reinterpret_cast<const char *>(sqlite3_value_blob(argv[i]));
+		result -= Roaring::readSafe(buf, bytes);
+	}
+	result.runOptimize();
+	vector<char> result_buf = vector<char>(result.getSizeInBytes());
+	result.write(result_buf.data());
+	sqlite3_result_blob(context, result_buf.data(), (int) result_buf.size(), SQLITE_TRANSIENT);
+	return;
+}
+
+/**
+ * Returns true if a table with the given name exists in the main schema of the given database.
+ */
+static bool main_table_exists(sqlite3 * db, const string & table_name) {
+	bool exists = false;
+	sqlite3_stmt * select_from_sqlite_master_stmt;
+	sqlite3_prepare(db, "SELECT 1 FROM main.sqlite_master WHERE type='table' AND name=?", -1, & select_from_sqlite_master_stmt, 0);
+	sqlite3_bind_text(select_from_sqlite_master_stmt, 1, table_name.c_str(), -1, SQLITE_STATIC);
+	if (sqlite3_step(select_from_sqlite_master_stmt) == SQLITE_ROW) {
+		exists = true;
+	}
+	sqlite3_finalize(select_from_sqlite_master_stmt);
+	return exists;
+}
+
+/**
+ * Returns true if the table with the given name in the main schema of the given database has a column with the given name.
+ */
+static bool main_column_exists(sqlite3 * db, const string & table_name, const string & column_name) {
+	bool exists = false;
+	sqlite3_stmt * select_from_table_info_stmt;
+	sqlite3_prepare(db, "SELECT 1 FROM pragma_table_info(?, 'main') WHERE name=?", -1, & select_from_table_info_stmt, 0);
+	sqlite3_bind_text(select_from_table_info_stmt, 1, table_name.c_str(), -1, SQLITE_STATIC);
+	sqlite3_bind_text(select_from_table_info_stmt, 2, column_name.c_str(), -1, SQLITE_STATIC);
+	if (sqlite3_step(select_from_table_info_stmt) == SQLITE_ROW) {
+		exists = true;
+	}
+	sqlite3_finalize(select_from_table_info_stmt);
+	return exists;
+}
+
+/**
+ * Executes the given SQL statements on the given database, exiting with an error (describing the given object) if they fail.
+ */
+static void execute_view_sql(sqlite3 * db, const string & sql, const string & object_name) {
+	char * error_msg;
+	int rc = sqlite3_exec(db, sql.c_str(), NULL, 0, & error_msg);
+	if (rc != SQLITE_OK) {
+		cerr << "Error creating " << object_name << ": " << error_msg << endl;
+		sqlite3_free(error_msg);
+		exit(1);
+	}
+	return;
+}
+
+/**
+ * Returns the number of witnesses in the WITNESSES table of the given database (or 1 if it is empty, so that it can be used as a divisor).
+ */
+static sqlite3_int64 get_num_wits(sqlite3 * db) {
+	sqlite3_int64 num_wits = 0;
+	sqlite3_stmt * select_from_witnesses_stmt;
+	sqlite3_prepare(db, "SELECT COUNT(*) FROM main.WITNESSES", -1, & select_from_witnesses_stmt, 0);
+	if (sqlite3_step(select_from_witnesses_stmt) == SQLITE_ROW) {
+		num_wits = sqlite3_column_int64(select_from_witnesses_stmt, 0);
+	}
+	sqlite3_finalize(select_from_witnesses_stmt);
+	return num_wits > 0 ? num_wits : 1;
+}
+
+/**
+ * Creates the GENEALOGICAL_COMPARISONS view over the GENEALOGICAL_COMPARISON_PAIRS table of the compact schema.
+ */
+static void create_compact_comparisons_view(sqlite3 * db) {
+	int rc; //to store SQLite macros
+	rc = sqlite3_create_function(db, "ROARING_ANDNOT", -1, SQLITE_UTF8 | SQLITE_DETERMINISTIC, NULL, roaring_andnot, NULL, NULL);
+	if (rc != SQLITE_OK) {
+		cerr << "Error registering function ROARING_ANDNOT: " << sqlite3_errmsg(db) << endl;
+		exit(1);
+	}
+	//Each pair's row ID is its primary witness's index times the number of witnesses plus its secondary witness's index,
+	//so the row ID of the mirrored comparison can be calculated from it:
+	string n = to_string(get_num_wits(db));
+	//Caches populated before relationship counts were stored do not have the count columns:
+	string counts_sql = string();
+	string mirrored_counts_sql = string();
+	if (main_column_exists(db, "GENEALOGICAL_COMPARISON_PAIRS", "EXTANT_COUNT")) {
+		counts_sql = ", EXTANT_COUNT, AGREEMENTS_COUNT, PRIOR_COUNT, POSTERIOR_COUNT, NOREL_COUNT, UNCLEAR_COUNT, EXPLAINED_COUNT";
+		mirrored_counts_sql = ", EXTANT_COUNT, AGREEMENTS_COUNT, POSTERIOR_COUNT, PRIOR_COUNT, NOREL_COUNT, UNCLEAR_COUNT, MIRRORED_EXPLAINED_COUNT";
+	}
+	//SQLite pushes a filter on the view's PRIMARY_WIT column down into both halves of the union,
+	//where it becomes a filter on the PRIMARY_WIT and SECONDARY_WIT columns of the table respectively, both of which are indexed:
+	string create_view_sql = "DROP VIEW IF EXISTS temp.GENEALOGICAL_COMPARISONS;"
+			"CREATE TEMP VIEW GENEALOGICAL_COMPARISONS AS "
+			"SELECT ROW_ID, PRIMARY_WIT, SECONDARY_WIT, EXTANT, AGREEMENTS, PRIOR, POSTERIOR, "
+			"ROARING_ANDNOT(EXTANT, AGREEMENTS, PRIOR, POSTERIOR, UNCLEAR) AS NOREL, UNCLEAR, EXPLAINED, COST" + counts_sql + " "
+			"FROM main.GENEALOGICAL_COMPARISON_PAIRS "
+			"UNION ALL "
+			"SELECT (ROW_ID % " + n + ") * " + n + " + ROW_ID / " + n + ", SECONDARY_WIT, PRIMARY_WIT, EXTANT, AGREEMENTS, POSTERIOR, PRIOR, "
+			"ROARING_ANDNOT(EXTANT, AGREEMENTS, PRIOR, POSTERIOR, UNCLEAR), UNCLEAR, MIRRORED_EXPLAINED, MIRRORED_COST" + mirrored_counts_sql + " "
+			"FROM main.GENEALOGICAL_COMPARISON_PAIRS WHERE PRIMARY_WIT<>SECONDARY_WIT;";
+	execute_view_sql(db, create_view_sql, "view GENEALOGICAL_COMPARISONS");
+	return;
+}
+
+/**
+ * Creates the GENEALOGICAL_COMPARISONS view over the GENEALOGICAL_COMPARISONS_CLUSTERED table of the clustered schema.
+ * The witness ordinals are mapped to and from witness IDs through a temporary copy of the WITNESSES table keyed by ordinal and indexed by ID,
+ * so that a filter on the view's PRIMARY_WIT column becomes a single range scan over the primary witness's contiguous rows,
+ * with each secondary witness's ID looked up by its ordinal.
+ */
+static void create_clustered_comparisons_view(sqlite3 * db) {
+	string n = to_string(get_num_wits(db));
+	string create_ordinals_sql = "DROP TABLE IF EXISTS temp.WITNESS_ORDINALS;"
+			"CREATE TEMP TABLE WITNESS_ORDINALS ("
+			"ORDINAL INTEGER PRIMARY KEY, "
+			"WITNESS TEXT NOT NULL UNIQUE);"
+			"INSERT INTO temp.WITNESS_ORDINALS SELECT ROW_ID, WITNESS FROM main.WITNESSES;";
+	execute_view_sql(db, create_ordinals_sql, "table WITNESS_ORDINALS");
+	//Caches populated before relationship counts were stored do not have the count columns:
+	string counts_sql = string();
+	if (main_column_exists(db, "GENEALOGICAL_COMPARISONS_CLUSTERED", "EXTANT_COUNT")) {
+		counts_sql = ", C.EXTANT_COUNT AS EXTANT_COUNT, C.AGREEMENTS_COUNT AS AGREEMENTS_COUNT, C.PRIOR_COUNT AS PRIOR_COUNT, C.POSTERIOR_COUNT AS POSTERIOR_COUNT, "
+				"C.NOREL_COUNT AS NOREL_COUNT, C.UNCLEAR_COUNT AS UNCLEAR_COUNT, C.EXPLAINED_COUNT AS EXPLAINED_COUNT";
+	}
+	string create_view_sql = "DROP VIEW IF EXISTS temp.GENEALOGICAL_COMPARISONS;"
+			"CREATE TEMP VIEW GENEALOGICAL_COMPARISONS AS "
+			"SELECT C.PRIMARY_WIT_ID * " + n + " + C.SECONDARY_WIT_ID AS ROW_ID, P.WITNESS AS PRIMARY_WIT, S.WITNESS AS SECONDARY_WIT, "
+			"C.EXTANT AS EXTANT, C.AGREEMENTS AS AGREEMENTS, C.PRIOR AS PRIOR, C.POSTERIOR AS POSTERIOR, C.NOREL AS NOREL, C.UNCLEAR AS UNCLEAR, C.EXPLAINED AS EXPLAINED, C.COST AS COST" + counts_sql + " "
+			"FROM temp.WITNESS_ORDINALS P "
+			"JOIN main.GENEALOGICAL_COMPARISONS_CLUSTERED C ON C.PRIMARY_WIT_ID=P.ORDINAL "
+			"JOIN temp.WITNESS_ORDINALS S ON S.ORDINAL=C.SECONDARY_WIT_ID;";
+	execute_view_sql(db, create_view_sql, "view GENEALOGICAL_COMPARISONS");
+	return;
+}
+
+bool attach_comparisons_view(sqlite3 * db) {
+	if (main_table_exists(db, "GENEALOGICAL_COMPARISON_PAIRS")) {
+		create_compact_comparisons_view(db);
+		return true;
+	}
+	if (main_table_exists(db, "GENEALOGICAL_COMPARISONS_CLUSTERED")) {
+		create_clustered_comparisons_view(db);
+		return true;
+	}
+	return false;
+}
@@ -0,0 +1,29 @@
+/*
+ * comparison_views.h
+ *
+ *  Created on: Oct 15, 2026
+ *      Author: jjmccollum
+ */
+
+#ifndef COMPARISON_VIEWS_H_
+#define COMPARISON_VIEWS_H_
+
+#include "sqlite3.h"
+
+using namespace std;
+
+/**
+ * If the genealogical cache in the given database stores its genealogical comparisons in a schema other than the full one,
+ * then creates a temporary GENEALOGICAL_COMPARISONS view on the given connection that presents them in the full schema,
+ * with a row for every ordered pair of witnesses whose columns are ROW_ID, PRIMARY_WIT, SECONDARY_WIT, EXTANT, AGREEMENTS,
+ * PRIOR, POSTERIOR, NOREL, UNCLEAR, EXPLAINED, and COST (followed by the relationship count columns, if the cache stores them),
+ * so that queries written for the full schema can be run unchanged.
+ * Two such schemas are recognized:
+ * the compact schema, in which the GENEALOGICAL_COMPARISON_PAIRS table stores each unordered pair of witnesses once,
+ * and the clustered schema, in which the GENEALOGICAL_COMPARISONS_CLUSTERED table is keyed by the witnesses' ordinals in the WITNESSES table.
+ * The return value will be true if the view was created, and false if the database uses the full schema.
+ * Exits with an error if the view cannot be created.
+ */
+bool attach_comparisons_view(sqlite3 * db);
+
+#endif /* COMPARISON_VIEWS_H_ */
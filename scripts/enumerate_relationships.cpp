@@ -16,107 +16,15 @@
 
 #include "cxxopts.hpp"
 #include "roaring.hh"
-#include "sqlite3.h"
 
 #include "enumerate_relationships_table.h"
 #include "witness.h"
 #include "local_stemma.h"
+#include "cache_reader.h"
 
 using namespace std;
 using namespace roaring;
 
-/**
- * Retrieves all rows from the VARIATION_UNITS table of the given SQLite database
- * and returns a vector of variation unit IDs populated with its contents.
- */
-vector<string> get_variation_unit_ids(sqlite3 * input_db) {
-	vector<string> variation_unit_ids = vector<string>();
-	int rc; //to store SQLite macros
-	sqlite3_stmt * select_from_variation_units_stmt;
-	sqlite3_prepare(input_db, "SELECT VARIATION_UNIT FROM VARIATION_UNITS ORDER BY ROW_ID", -1, & select_from_variation_units_stmt, 0);
-	rc = sqlite3_step(select_from_variation_units_stmt);
-	while (rc == SQLITE_ROW) {
-		string vu_id = string(reinterpret_cast<const char *>(sqlite3_column_text(select_from_variation_units_stmt, 0)));
-		variation_unit_ids.push_back(vu_id);
-		rc = sqlite3_step(select_from_variation_units_stmt);
-	}
-	sqlite3_finalize(select_from_variation_units_stmt);
-	return variation_unit_ids;
-}
-
-/**
- * Retrieves all rows with the given witness ID from the GENEALOGICAL_COMPARISONS table of the given SQLite database
- * and returns a flag indicating whether such a witness exists.
- */
-bool witness_exists(sqlite3 * input_db, const string & wit_id) {
-	bool witness_exists = false;
-	int rc; //to store SQLite macros
-	sqlite3_stmt * select_from_genealogical_comparisons_stmt;
-	sqlite3_prepare(input_db, "SELECT * FROM GENEALOGICAL_COMPARISONS WHERE PRIMARY_WIT=? ORDER BY ROW_ID", -1, & select_from_genealogical_comparisons_stmt, 0);
-	sqlite3_bind_text(select_from_genealogical_comparisons_stmt, 1, wit_id.c_str(), -1, SQLITE_STATIC);
-	rc = sqlite3_step(select_from_genealogical_comparisons_stmt);
-	while (rc == SQLITE_ROW) {
-		witness_exists = true;
-		break;
-	}
-	sqlite3_finalize(select_from_genealogical_comparisons_stmt);
-	return witness_exists;
-}
-
-/**
- * Using a row for the given primary and secondary witness IDs from the GENEALOGICAL_COMPARISONS table of the given SQLite database,
- * returns a genealogical comparison.
- */
-genealogical_comparison get_genealogical_comparison(sqlite3 * input_db, const string & primary_wit_id, const string & secondary_wit_id) {
-	int rc; //to store SQLite macros
-	//Populate this witness's list of genealogical comparisons to other witnesses:
-	genealogical_comparison comp = genealogical_comparison();
-	sqlite3_stmt * select_from_genealogical_comparisons_stmt;
-	sqlite3_prepare(input_db, "SELECT * FROM GENEALOGICAL_COMPARISONS WHERE PRIMARY_WIT=? AND SECONDARY_WIT=? ORDER BY ROW_ID", -1, & select_from_genealogical_comparisons_stmt, 0);
-	sqlite3_bind_text(select_from_genealogical_comparisons_stmt, 1, primary_wit_id.c_str(), -1, SQLITE_STATIC);
-	sqlite3_bind_text(select_from_genealogical_comparisons_stmt, 2, secondary_wit_id.c_str(), -1, SQLITE_STATIC);
-	rc = sqlite3_step(select_from_genealogical_comparisons_stmt);
-	while (rc == SQLITE_ROW) {
-		string primary_wit_id = string(reinterpret_cast<const char *>(sqlite3_column_text(select_from_genealogical_comparisons_stmt, 1)));
-		comp.primary_wit = primary_wit_id;
-		string secondary_wit_id = string(reinterpret_cast<const char *>(sqlite3_column_text(select_from_genealogical_comparisons_stmt, 2)));
-		comp.secondary_wit = secondary_wit_id;
-		int extant_bytes = sqlite3_column_bytes(select_from_genealogical_comparisons_stmt, 3);
-		const char * extant_buf = reinterpret_cast<const char *>(sqlite3_column_blob(select_from_genealogical_comparisons_stmt, 3));
-		Roaring extant = Roaring::readSafe(extant_buf, extant_bytes);
-		comp.extant = extant;
-		int agreements_bytes = sqlite3_column_bytes(select_from_genealogical_comparisons_stmt, 4);
-		const char * agreements_buf = reinterpret_cast<const char *>(sqlite3_column_blob(select_from_genealogical_comparisons_stmt, 4));
-		Roaring agreements = Roaring::readSafe(agreements_buf, agreements_bytes);
-		comp.agreements = agreements;
-		int prior_bytes = sqlite3_column_bytes(select_from_genealogical_comparisons_stmt, 5);
-		const char * prior_buf = reinterpret_cast<const char *>(sqlite3_column_blob(select_from_genealogical_comparisons_stmt, 5));
-		Roaring prior = Roaring::readSafe(prior_buf, prior_bytes);
-		comp.prior = prior;
-		int posterior_bytes = sqlite3_column_bytes(select_from_genealogical_comparisons_stmt, 6);
-		const char * posterior_buf = reinterpret_cast<const char *>(sqlite3_column_blob(select_from_genealogical_comparisons_stmt, 6));
-		Roaring posterior = Roaring::readSafe(posterior_buf, posterior_bytes);
-		comp.posterior = posterior;
-		int norel_bytes = sqlite3_column_bytes(select_from_genealogical_comparisons_stmt, 7);
-		const char * norel_buf = reinterpret_cast<const char *>(sqlite3_column_blob(select_from_genealogical_comparisons_stmt, 7));
-		Roaring norel = Roaring::readSafe(norel_buf, norel_bytes);
-		comp.norel = norel;
-		int unclear_bytes = sqlite3_column_bytes(select_from_genealogical_comparisons_stmt, 8);
-		const char * unclear_buf = reinterpret_cast<const char *>(sqlite3_column_blob(select_from_genealogical_comparisons_stmt, 8));
-		Roaring unclear = Roaring::readSafe(unclear_buf, unclear_bytes);
-		comp.unclear = unclear;
-		int explained_bytes = sqlite3_column_bytes(select_from_genealogical_comparisons_stmt, 9);
-		const char * explained_buf = reinterpret_cast<const char *>(sqlite3_column_blob(select_from_genealogical_comparisons_stmt, 9));
-		Roaring explained = Roaring::readSafe(explained_buf, explained_bytes);
-		comp.explained = explained;
-		float cost = float(sqlite3_column_double(select_from_genealogical_comparisons_stmt, 10));
-		comp.cost = cost;
-		break;
-	}
-	sqlite3_finalize(select_from_genealogical_comparisons_stmt);
-	return comp;
-}
-
 /**
  * Entry point to the script.
  */
@@ -191,30 +99,38 @@ int main(int argc, char* argv[]) {
 	}
 	//Open the database:
 	cout << "Opening database..." << endl;
-	sqlite3 * input_db;
-	int rc = sqlite3_open(input_db_name.c_str(), & input_db);
-	if (rc) {
-		cerr << "Error opening database " << input_db_name << ": " << sqlite3_errmsg(input_db) << endl;
+	cache_reader reader;
+	string error_msg = string();
+	if (!reader.open(input_db_name, error_msg)) {
+		cerr << "Error opening database " << input_db_name << ": " << error_msg << endl;
 		exit(1);
 	}
 	cout << "Retrieving variation unit list..." << endl;
 	//Retrieve all variation unit IDs in the order in which they occur in the table:
-	vector<string> variation_unit_ids = get_variation_unit_ids(input_db);
+	vector<string> variation_unit_ids = reader.get_variation_unit_ids();
 	cout << "Retrieving genealogical comparison between primary witness and secondary witness..." << endl;
 	//Get the genealogical relationship, if both witnesses exist:
-	if (!witness_exists(input_db, primary_wit_id)) {
+	if (!reader.witness_exists(primary_wit_id)) {
 		cerr << "Error: there are no rows in the GENEALOGICAL_COMPARISONS table for witness " << primary_wit_id << "." << endl;
 		exit(1);
 	}
-	if (!witness_exists(input_db, secondary_wit_id)) {
+	if (!reader.witness_exists(secondary_wit_id)) {
 		cerr << "Error: there are no rows in the GENEALOGICAL_COMPARISONS table for witness " << secondary_wit_id << "." << endl;
 		exit(1);
 	}
-	genealogical_comparison comp = get_genealogical_comparison(input_db, primary_wit_id, secondary_wit_id);
+	//Only read the bitmaps for the relationship types to be enumerated:
+	unordered_map<string, unsigned int> relationship_type_columns = unordered_map<string, unsigned int>({{"extant", EXTANT_COLUMN}, {"agree", AGREEMENTS_COLUMN}, {"prior", PRIOR_COLUMN}, {"posterior", POSTERIOR_COLUMN}, {"norel", NOREL_COLUMN}, {"unclear", UNCLEAR_COLUMN}, {"explained", EXPLAINED_COLUMN}});
+	unsigned int columns = 0;
+	for (string relationship_type : filter_relationship_types) {
+		columns |= relationship_type_columns[relationship_type];
+	}
+	lazy_genealogical_comparison lazy_comp = reader.get_lazy_genealogical_comparison(primary_wit_id, secondary_wit_id, columns);
 	//Close the database:
 	cout << "Closing database..." << endl;
-	sqlite3_close(input_db);
+	reader.close();
 	cout << "Database closed." << endl;
+	//The table is populated from a decoded comparison, so decode the bitmaps for the relationship types to be enumerated (and only those):
+	genealogical_comparison comp = lazy_comp.get_genealogical_comparison(columns);
 	//Then initialize the table:
 	enumerate_relationships_table table = enumerate_relationships_table(comp, variation_unit_ids);
 	//Then write to the appropriate output:
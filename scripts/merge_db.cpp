@@ -0,0 +1,389 @@
+/*
+ * merge_db.cpp
+ *
+ *  Created on: Oct 15, 2026
+ *      Author: jjmccollum
+ */
+
+#ifdef _WIN32
+	#include <cstdlib> //for _fullpath
+	#include <cstring> //for _stricmp
+#else
+	#include <sys/stat.h> //for identifying files by device and inode
+#endif
+#include <iostream>
+#include <cstdio>
+#include <string>
+#include <list>
+#include <vector>
+#include <set>
+#include <map>
+
+#include "cxxopts.hpp"
+#include "sqlite3.h"
+
+using namespace std;
+
+/**
+ * Tables whose rows are divided among the shards of a genealogical cache.
+ * Every other table describes the apparatus and must be identical in every shard.
+ */
+const set<string> sharded_tables = set<string>({"GENEALOGICAL_COMPARISONS", "GENEALOGICAL_COMPARISON_PAIRS", "GENEALOGICAL_COMPARISONS_CLUSTERED", "COMPARISON_PROGRESS"});
+
+/**
+ * Executes the given SQL statements on the given database, exiting with an error if they fail.
+ */
+void execute_sql(sqlite3 * db, const string & sql) {
+	char * error_msg;
+	int rc = sqlite3_exec(db, sql.c_str(), NULL, NULL, & error_msg);
+	if (rc != SQLITE_OK) {
+		cerr << "Error executing SQL statement \"" << sql << "\": " << error_msg << endl;
+		sqlite3_free(error_msg);
+		exit(1);
+	}
+	return;
+}
+
+/**
+ * Returns the integer result of the given single-valued query on the given database.
+ */
+sqlite3_int64 select_int(sqlite3 * db, const string & sql) {
+	int rc; //to store SQLite macros
+	sqlite3_stmt * select_stmt;
+	rc = sqlite3_prepare(db, sql.c_str(), -1, & select_stmt, 0);
+	if (rc != SQLITE_OK) {
+		cerr << "Error preparing statement \"" << sql << "\": " << sqlite3_errmsg(db) << endl;
+		exit(1);
+	}
+	sqlite3_int64 value = 0;
+	if (sqlite3_step(select_stmt) == SQLITE_ROW) {
+		value = sqlite3_column_int64(select_stmt, 0);
+	}
+	sqlite3_finalize(select_stmt);
+	return value;
+}
+
+/**
+ * Reads the SHARD value from the METADATA table of the given shard database and parses it into a shard number (counting from 1) and a number of shards.
+ * Exits with an error if the database was not populated with the --shard option of populate_db.
+ */
+void read_shard(const string & shard_db_name, unsigned int & shard_num, unsigned int & shard_count) {
+	int rc; //to store SQLite macros
+	sqlite3 * shard_db;
+	rc = sqlite3_open_v2(shard_db_name.c_str(), & shard_db, SQLITE_OPEN_READONLY, NULL);
+	if (rc) {
+		cerr << "Error opening database " << shard_db_name << ": " << sqlite3_errmsg(shard_db) << endl;
+		exit(1);
+	}
+	string shard_value = string();
+	sqlite3_stmt * select_from_metadata_stmt;
+	rc = sqlite3_prepare(shard_db, "SELECT VALUE FROM METADATA WHERE KEY='SHARD'", -1, & select_from_metadata_stmt, 0);
+	if (rc == SQLITE_OK && sqlite3_step(select_from_metadata_stmt) == SQLITE_ROW) {
+		shard_value = string(reinterpret_cast<const char *>(sqlite3_column_text(select_from_metadata_stmt, 0)));
+	}
+	sqlite3_finalize(select_from_metadata_stmt);
+	sqlite3_close(shard_db);
+	if (sscanf(shard_value.c_str(), "%u/%u", & shard_num, & shard_count) != 2) {
+		cerr << "Error: database " << shard_db_name << " is not a shard; please populate it using populate_db with the --shard option." << endl;
+		exit(1);
+	}
+	return;
+}
+
+/**
+ * Returns true if the files with the given names are the same file.
+ * A file that does not exist is not the same as any other file.
+ */
+bool same_file(const string & file_name_1, const string & file_name_2) {
+	#ifdef _WIN32
+		char full_path_1[_MAX_PATH];
+		char full_path_2[_MAX_PATH];
+		if (_fullpath(full_path_1, file_name_1.c_str(), _MAX_PATH) == NULL || _fullpath(full_path_2, file_name_2.c_str(), _MAX_PATH) == NULL) {
+			return file_name_1 == file_name_2;
+		}
+		return _stricmp(full_path_1, full_path_2) == 0;
+	#else
+		struct stat st_1;
+		struct stat st_2;
+		if (stat(file_name_1.c_str(), & st_1) != 0 || stat(file_name_2.c_str(), & st_2) != 0) {
+			return false;
+		}
+		return st_1.st_dev == st_2.st_dev && st_1.st_ino == st_2.st_ino;
+	#endif
+}
+
+/**
+ * Attaches the database with the given name to the given connection under the given schema name.
+ * Exits with an error if it cannot be attached.
+ */
+void attach_database(sqlite3 * db, const string & db_name, const string & schema_name) {
+	int rc; //to store SQLite macros
+	sqlite3_stmt * attach_stmt;
+	sqlite3_prepare(db, ("ATTACH DATABASE ? AS " + schema_name).c_str(), -1, & attach_stmt, 0);
+	sqlite3_bind_text(attach_stmt, 1, db_name.c_str(), -1, SQLITE_STATIC);
+	rc = sqlite3_step(attach_stmt);
+	sqlite3_finalize(attach_stmt);
+	if (rc != SQLITE_DONE) {
+		cerr << "Error attaching database " << db_name << ": " << sqlite3_errmsg(db) << endl;
+		exit(1);
+	}
+	return;
+}
+
+/**
+ * Returns a map from the name of each table in the attached database with the given schema name to the SQL statement that created it,
+ * and adds the SQL statements that created its indexes to the given list.
+ * SQLite's internal tables (such as the statistics gathered by ANALYZE) are skipped.
+ */
+map<string, string> read_shard_schema(sqlite3 * db, const string & schema_name, list<string> & index_sqls) {
+	int rc; //to store SQLite macros
+	map<string, string> table_sqls = map<string, string>();
+	index_sqls.clear();
+	sqlite3_stmt * select_from_sqlite_master_stmt;
+	string select_from_sqlite_master_sql = "SELECT TYPE, NAME, SQL FROM " + schema_name + ".sqlite_master WHERE SQL IS NOT NULL AND NAME NOT LIKE 'sqlite\\_%' ESCAPE '\\' ORDER BY ROWID";
+	sqlite3_prepare(db, select_from_sqlite_master_sql.c_str(), -1, & select_from_sqlite_master_stmt, 0);
+	rc = sqlite3_step(select_from_sqlite_master_stmt);
+	while (rc == SQLITE_ROW) {
+		string type = string(reinterpret_cast<const char *>(sqlite3_column_text(select_from_sqlite_master_stmt, 0)));
+		string name = string(reinterpret_cast<const char *>(sqlite3_column_text(select_from_sqlite_master_stmt, 1)));
+		string sql = string(reinterpret_cast<const char *>(sqlite3_column_text(select_from_sqlite_master_stmt, 2)));
+		if (type == "table") {
+			table_sqls[name] = sql;
+		}
+		else if (type == "index") {
+			index_sqls.push_back(sql);
+		}
+		rc = sqlite3_step(select_from_sqlite_master_stmt);
+	}
+	sqlite3_finalize(select_from_sqlite_master_stmt);
+	return table_sqls;
+}
+
+/**
+ * Returns true if the given apparatus table holds the same rows in the attached databases with the given schema names.
+ * The SHARD entry of the METADATA table is expected to differ between shards, so it is ignored.
+ */
+bool tables_match(sqlite3 * db, const string & schema_name_1, const string & schema_name_2, const string & table_name) {
+	string filter = table_name == "METADATA" ? " WHERE KEY<>'SHARD'" : "";
+	string rows_1 = "SELECT * FROM " + schema_name_1 + "." + table_name + filter;
+	string rows_2 = "SELECT * FROM " + schema_name_2 + "." + table_name + filter;
+	if (select_int(db, "SELECT COUNT(*) FROM (" + rows_1 + ")") != select_int(db, "SELECT COUNT(*) FROM (" + rows_2 + ")")) {
+		return false;
+	}
+	if (select_int(db, "SELECT EXISTS (" + rows_1 + " EXCEPT " + rows_2 + ")") != 0) {
+		return false;
+	}
+	if (select_int(db, "SELECT EXISTS (" + rows_2 + " EXCEPT " + rows_1 + ")") != 0) {
+		return false;
+	}
+	return true;
+}
+
+/**
+ * Checks that the shard databases with the given names have the same tables and indexes
+ * and the same contents in every table that is not divided among the shards (and so the same collation, witness list, and options),
+ * comparing each to the first on a temporary connection, so that nothing is written until every shard has been checked.
+ * Exits with an error if any shard differs from the first.
+ */
+void check_shards_match(const vector<string> & shard_db_names) {
+	sqlite3 * check_db;
+	int rc = sqlite3_open(":memory:", & check_db);
+	if (rc) {
+		cerr << "Error opening temporary database: " << sqlite3_errmsg(check_db) << endl;
+		exit(1);
+	}
+	attach_database(check_db, shard_db_names[0], "FIRST");
+	list<string> index_sqls = list<string>();
+	map<string, string> table_sqls = read_shard_schema(check_db, "FIRST", index_sqls);
+	for (unsigned int i = 1; i < shard_db_names.size(); i++) {
+		const string & shard_db_name = shard_db_names[i];
+		attach_database(check_db, shard_db_name, "SHARD");
+		list<string> shard_index_sqls = list<string>();
+		if (read_shard_schema(check_db, "SHARD", shard_index_sqls) != table_sqls || shard_index_sqls != index_sqls) {
+			cerr << "Error: the tables of database " << shard_db_name << " differ from those of database " << shard_db_names[0] << "; please populate all shards with the same version of populate_db." << endl;
+			exit(1);
+		}
+		for (const pair<const string, string> & kv : table_sqls) {
+			if (sharded_tables.find(kv.first) == sharded_tables.end() && !tables_match(check_db, "FIRST", "SHARD", kv.first)) {
+				cerr << "Error: table " << kv.first << " of database " << shard_db_name << " differs from that of database " << shard_db_names[0] << "; please populate all shards from the same collation with the same options." << endl;
+				exit(1);
+			}
+		}
+		execute_sql(check_db, "DETACH DATABASE SHARD");
+	}
+	sqlite3_close(check_db);
+	return;
+}
+
+/**
+ * Checks that the merged database holds exactly one genealogical comparison for every ordered pair of witnesses in its WITNESSES table
+ * (or, if it uses the compact schema, exactly one row for every unordered pair of witnesses, in either order),
+ * so that a shard that is incomplete or that duplicates another's comparisons is caught even if the total number of rows happens to be right.
+ * This must be done after the merged tables are indexed, since each pair is looked up in the index.
+ * The return value will be true if the comparisons are complete, and false (with the given error message set) otherwise.
+ */
+bool comparisons_complete(sqlite3 * output_db, bool compact, bool clustered, string & error_msg) {
+	sqlite3_int64 num_wits = select_int(output_db, "SELECT COUNT(*) FROM WITNESSES");
+	string table_name = compact ? "GENEALOGICAL_COMPARISON_PAIRS" : (clustered ? "GENEALOGICAL_COMPARISONS_CLUSTERED" : "GENEALOGICAL_COMPARISONS");
+	//The clustered schema identifies witnesses by their ordinals, and the other schemas by their IDs:
+	string primary_col = clustered ? "PRIMARY_WIT_ID" : "PRIMARY_WIT";
+	string secondary_col = clustered ? "SECONDARY_WIT_ID" : "SECONDARY_WIT";
+	string wit_col = clustered ? "ROW_ID" : "WITNESS";
+	//Check that no pair of witnesses has more than one row:
+	string pair_sql = compact ? "MIN(" + primary_col + ", " + secondary_col + "), MAX(" + primary_col + ", " + secondary_col + ")" : primary_col + ", " + secondary_col;
+	if (select_int(output_db, "SELECT EXISTS (SELECT 1 FROM " + table_name + " GROUP BY " + pair_sql + " HAVING COUNT(*) > 1)") != 0) {
+		error_msg = "some pairs of witnesses have more than one genealogical comparison; please make sure that every shard was populated with the same --shard count";
+		return false;
+	}
+	//Then check that every pair of witnesses has a row:
+	string match_sql = "(C." + primary_col + "=P." + wit_col + " AND C." + secondary_col + "=S." + wit_col + ")";
+	if (compact) {
+		match_sql += " OR (C." + primary_col + "=S." + wit_col + " AND C." + secondary_col + "=P." + wit_col + ")";
+	}
+	sqlite3_int64 num_missing = select_int(output_db, "SELECT COUNT(*) FROM WITNESSES AS P INNER JOIN WITNESSES AS S" + string(compact ? " ON P.ROW_ID<=S.ROW_ID" : "")
+			+ " WHERE NOT EXISTS (SELECT 1 FROM " + table_name + " AS C WHERE " + match_sql + ")");
+	if (num_missing > 0) {
+		error_msg = "the genealogical comparisons of " + to_string(num_missing) + " pairs of witnesses are missing; please finish any interrupted shards using populate_db with the --resume option";
+		return false;
+	}
+	//Finally, check that there are no rows for witnesses outside of the witness list:
+	sqlite3_int64 num_comparisons = select_int(output_db, "SELECT COUNT(*) FROM " + table_name);
+	sqlite3_int64 expected_num_comparisons = compact ? num_wits * (num_wits + 1) / 2 : num_wits * num_wits;
+	if (num_comparisons != expected_num_comparisons) {
+		error_msg = "the shards hold " + to_string(num_comparisons) + " genealogical comparisons, but " + to_string(expected_num_comparisons) + " were expected";
+		return false;
+	}
+	return true;
+}
+
+/**
+ * Entry point to the script.
+ */
+int main(int argc, char* argv[]) {
+	//Read in the command-line options:
+	string output_db_name = string();
+	vector<string> shard_db_names = vector<string>();
+	try {
+		cxxopts::Options options("merge_db", "Combine the shard databases populated by populate_db with the --shard option into a single genealogical cache.\nThe apparatus tables of every shard must be identical, and every shard must be given exactly once.");
+		options.custom_help("[-h] output_db shard_db_1 shard_db_2 ...");
+		options.positional_help("").show_positional_help();
+		options.add_options("")
+				("h,help", "print this help");
+		options.add_options("positional")
+				("output_db", "output SQLite database (if an existing database is provided, it will be replaced)", cxxopts::value<string>())
+				("shard_dbs", "shard databases to be merged", cxxopts::value<vector<string>>());
+		options.parse_positional({"output_db", "shard_dbs"});
+		auto args = options.parse(argc, argv);
+		//Print help documentation and exit if specified:
+		if (args.count("help")) {
+			cout << options.help({"", "positional"}) << endl;
+			exit(0);
+		}
+		//Parse the positional arguments:
+		if (!args.count("output_db") || !args.count("shard_dbs")) {
+			cerr << "Error: At least 2 positional arguments (output_db and shard_db_1) are required." << endl;
+			exit(1);
+		}
+		else {
+			output_db_name = args["output_db"].as<string>();
+			shard_db_names = args["shard_dbs"].as<vector<string>>();
+		}
+	}
+	catch (const cxxopts::OptionException & e) {
+		cerr << "Error parsing options: " << e.what() << endl;
+		exit(-1);
+	}
+	//Check that the shard databases cover every shard exactly once:
+	cout << "Checking shards..." << endl;
+	unsigned int num_shards = 0;
+	set<unsigned int> shard_nums = set<unsigned int>();
+	for (const string & shard_db_name : shard_db_names) {
+		unsigned int shard_num = 0;
+		unsigned int shard_count = 0;
+		read_shard(shard_db_name, shard_num, shard_count);
+		if (num_shards == 0) {
+			num_shards = shard_count;
+		}
+		else if (shard_count != num_shards) {
+			cerr << "Error: database " << shard_db_name << " is shard " << shard_num << " of " << shard_count << ", but the other databases are shards of " << num_shards << "." << endl;
+			exit(1);
+		}
+		if (shard_nums.find(shard_num) != shard_nums.end()) {
+			cerr << "Error: shard " << shard_num << " of " << num_shards << " was given more than once." << endl;
+			exit(1);
+		}
+		shard_nums.insert(shard_num);
+	}
+	if (shard_nums.size() != num_shards) {
+		cerr << "Error: only " << shard_nums.size() << " of " << num_shards << " shards were given." << endl;
+		exit(1);
+	}
+	//The output database is replaced, so it must not be one of the shards:
+	for (const string & shard_db_name : shard_db_names) {
+		if (same_file(output_db_name, shard_db_name)) {
+			cerr << "Error: the output database " << output_db_name << " is also given as shard database " << shard_db_name << "; please write the merged database to a new file." << endl;
+			exit(1);
+		}
+	}
+	//Then check that the shards were populated from the same collation with the same options before anything is written:
+	check_shards_match(shard_db_names);
+	//Then open the output database, replacing any existing one:
+	cout << "Opening database..." << endl;
+	remove(output_db_name.c_str());
+	sqlite3 * output_db;
+	int rc = sqlite3_open(output_db_name.c_str(), & output_db);
+	if (rc) {
+		cerr << "Error opening database " << output_db_name << ": " << sqlite3_errmsg(output_db) << endl;
+		exit(1);
+	}
+	execute_sql(output_db, "PRAGMA journal_mode=OFF; PRAGMA synchronous=OFF;");
+	//Copy the contents of each shard in turn:
+	map<string, string> table_sqls = map<string, string>();
+	list<string> index_sqls = list<string>();
+	for (unsigned int i = 0; i < shard_db_names.size(); i++) {
+		const string & shard_db_name = shard_db_names[i];
+		cout << "Merging shard database " << shard_db_name << "..." << endl;
+		attach_database(output_db, shard_db_name, "SHARD");
+		execute_sql(output_db, "BEGIN TRANSACTION");
+		//The shards were checked to have the same schema and apparatus tables above,
+		//so the first shard determines the schema, which is created without indexes until all rows have been copied,
+		//and supplies the contents of the apparatus tables:
+		if (i == 0) {
+			table_sqls = read_shard_schema(output_db, "SHARD", index_sqls);
+			for (const pair<const string, string> & kv : table_sqls) {
+				execute_sql(output_db, kv.second);
+				if (sharded_tables.find(kv.first) == sharded_tables.end()) {
+					string filter = kv.first == "METADATA" ? " WHERE KEY<>'SHARD'" : "";
+					execute_sql(output_db, "INSERT INTO main." + kv.first + " SELECT * FROM SHARD." + kv.first + filter);
+				}
+			}
+		}
+		for (const string & table_name : sharded_tables) {
+			if (table_sqls.find(table_name) != table_sqls.end()) {
+				execute_sql(output_db, "INSERT INTO main." + table_name + " SELECT * FROM SHARD." + table_name);
+			}
+		}
+		execute_sql(output_db, "END TRANSACTION");
+		execute_sql(output_db, "DETACH DATABASE SHARD");
+	}
+	//Then index the merged tables:
+	cout << "Creating indexes..." << endl;
+	for (const string & index_sql : index_sqls) {
+		execute_sql(output_db, index_sql);
+	}
+	//Finally, check that every shard was complete, so that there is exactly one comparison for every pair of witnesses:
+	cout << "Checking genealogical comparisons..." << endl;
+	bool compact = table_sqls.find("GENEALOGICAL_COMPARISON_PAIRS") != table_sqls.end();
+	bool clustered = table_sqls.find("GENEALOGICAL_COMPARISONS_CLUSTERED") != table_sqls.end();
+	string error_msg = string();
+	if (!comparisons_complete(output_db, compact, clustered, error_msg)) {
+		cerr << "Error: " << error_msg << "." << endl;
+		sqlite3_close(output_db);
+		remove(output_db_name.c_str());
+		exit(1);
+	}
+	cout << "Closing database..." << endl;
+	sqlite3_close(output_db);
+	cout << "Database closed." << endl;
+	exit(0);
+}
@@ -8,8 +8,25 @@
  *
  */
 
+#ifdef _WIN32
+	#define NOMINMAX //to prevent windows.h from defining min and max macros
+	#include <windows.h> //for Windows file mapping support
+	#include <psapi.h> //for Windows process memory counters
+#else
+	#include <sys/mman.h> //for POSIX memory mapping support
+	#include <sys/resource.h> //for POSIX resource usage counters
+	#include <sys/stat.h>
+	#include <fcntl.h>
+	#include <unistd.h>
+#endif
 #include <iostream>
 #include <sstream>
+#include <fstream>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cctype>
 #include <string>
 #include <list>
 #include <vector>
@@ -17,6 +34,9 @@
 #include <unordered_map>
 #include <thread>
 #include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include <algorithm>
 #include <chrono>
 
 #include "cxxopts.hpp"
@@ -27,16 +47,781 @@
 #include "apparatus.h"
 #include "variation_unit.h"
 #include "local_stemma.h"
+#include "comparison_engine.h"
+#include "cache_snapshot.h"
+#include "comparison_views.h"
+#include "cache_reader.h"
+#include "bounded_queue.h"
 
 
 using namespace std;
 using namespace pugi;
 using namespace roaring;
 
+/**
+ * Returns the peak resident memory usage of this process in kilobytes,
+ * or 0 if it cannot be determined on this platform.
+ */
+long long get_peak_memory_usage() {
+	#ifdef _WIN32
+		PROCESS_MEMORY_COUNTERS pmc;
+		if (!GetProcessMemoryInfo(GetCurrentProcess(), & pmc, sizeof(pmc))) {
+			return 0;
+		}
+		return (long long) (pmc.PeakWorkingSetSize / 1024);
+	#else
+		struct rusage usage;
+		if (getrusage(RUSAGE_SELF, & usage) != 0) {
+			return 0;
+		}
+		#ifdef __APPLE__
+			return (long long) (usage.ru_maxrss / 1024); //macOS reports this value in bytes rather than kilobytes
+		#else
+			return (long long) usage.ru_maxrss;
+		#endif
+	#endif
+}
+
+/**
+ * Prints the peak resident memory usage of this process so far, prefixed by the given message.
+ */
+void print_peak_memory_usage(const string & msg) {
+	long long peak_kb = get_peak_memory_usage();
+	if (peak_kb == 0) {
+		return;
+	}
+	cout << msg << (peak_kb / 1024) << " MB" << endl;
+	return;
+}
+
+/**
+ * Returns the CPU time (user and system) consumed by all threads of this process so far, in seconds.
+ */
+double get_cpu_time() {
+	#ifdef _WIN32
+		FILETIME creation_time, exit_time, kernel_time, user_time;
+		if (!GetProcessTimes(GetCurrentProcess(), & creation_time, & exit_time, & kernel_time, & user_time)) {
+			return 0;
+		}
+		ULARGE_INTEGER kernel, user;
+		kernel.LowPart = kernel_time.dwLowDateTime;
+		kernel.HighPart = kernel_time.dwHighDateTime;
+		user.LowPart = user_time.dwLowDateTime;
+		user.HighPart = user_time.dwHighDateTime;
+		return (double) (kernel.QuadPart + user.QuadPart) / 1e7; //FILETIME values are in units of 100 nanoseconds
+	#else
+		struct rusage usage;
+		if (getrusage(RUSAGE_SELF, & usage) != 0) {
+			return 0;
+		}
+		return (double) (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) + (double) (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+	#endif
+}
+
+/**
+ * Resource usage of one phase of a populate_db run.
+ */
+struct phase_stats {
+	string name;
+	double wall_seconds;
+	double cpu_seconds;
+	long long rows; //rows inserted, updated, or deleted in the database
+	long long blob_bytes; //bytes of BLOB data written to the database
+	long long peak_rss_kb; //peak resident memory usage of the process by the end of the phase
+};
+
+/**
+ * Records the resource usage of the phases of a populate_db run, in the order in which they begin.
+ * A phase that is begun more than once (e.g., parsing, which alternates with apparatus construction in streaming mode)
+ * accumulates its times and counts across all of its intervals.
+ */
+class stats_report {
+private:
+	vector<phase_stats> phases;
+	size_t current_phase_ind;
+	chrono::high_resolution_clock::time_point phase_wall_start;
+	double phase_cpu_start;
+	sqlite3 * phase_db;
+	int phase_changes_start;
+	chrono::high_resolution_clock::time_point run_wall_start;
+	double run_cpu_start;
+public:
+	stats_report();
+	void begin_phase(const string & name, sqlite3 * db = NULL);
+	void end_phase(long long blob_bytes = 0);
+	void write_json(const string & json_name, const string & input_xml_name, const string & output_db_name, unsigned int num_threads) const;
+};
+
+/**
+ * Default constructor; the run is timed from the moment the report is constructed.
+ */
+stats_report::stats_report() {
+	phases = vector<phase_stats>();
+	current_phase_ind = 0;
+	phase_cpu_start = 0;
+	phase_db = NULL;
+	phase_changes_start = 0;
+	run_wall_start = chrono::high_resolution_clock::now();
+	run_cpu_start = get_cpu_time();
+}
+
+/**
+ * Begins timing the phase with the given name.
+ * If a database is given, then the rows changed in it during the phase are counted.
+ */
+void stats_report::begin_phase(const string & name, sqlite3 * db) {
+	current_phase_ind = phases.size();
+	for (size_t i = 0; i < phases.size(); i++) {
+		if (phases[i].name == name) {
+			current_phase_ind = i;
+			break;
+		}
+	}
+	if (current_phase_ind == phases.size()) {
+		phase_stats stats;
+		stats.name = name;
+		stats.wall_seconds = 0;
+		stats.cpu_seconds = 0;
+		stats.rows = 0;
+		stats.blob_bytes = 0;
+		stats.peak_rss_kb = 0;
+		phases.push_back(stats);
+	}
+	phase_db = db;
+	phase_changes_start = db != NULL ? sqlite3_total_changes(db) : 0;
+	phase_cpu_start = get_cpu_time();
+	phase_wall_start = chrono::high_resolution_clock::now();
+	return;
+}
+
+/**
+ * Ends timing the current phase, adding the given number of bytes of BLOB data written during it.
+ */
+void stats_report::end_phase(long long blob_bytes) {
+	chrono::duration<double> wall_diff = chrono::high_resolution_clock::now() - phase_wall_start;
+	phase_stats & stats = phases[current_phase_ind];
+	stats.wall_seconds += wall_diff.count();
+	stats.cpu_seconds += get_cpu_time() - phase_cpu_start;
+	if (phase_db != NULL) {
+		stats.rows += sqlite3_total_changes(phase_db) - phase_changes_start;
+	}
+	stats.blob_bytes += blob_bytes;
+	stats.peak_rss_kb = get_peak_memory_usage();
+	return;
+}
+
+/**
+ * Returns the given string as a quoted JSON string literal.
+ */
+string json_string(const string & s) {
+	stringstream ss;
+	ss << '"';
+	for (unsigned char c : s) {
+		if (c == '"' || c == '\\') {
+			ss << '\\' << c;
+		}
+		else if (c < 0x20) {
+			char escape[7];
+			snprintf(escape, sizeof(escape), "\\u%04x", c);
+			ss << escape;
+		}
+		else {
+			ss << c;
+		}
+	}
+	ss << '"';
+	return ss.str();
+}
+
+/**
+ * Writes the recorded statistics, along with totals for the whole run so far, to a JSON file with the given name.
+ */
+void stats_report::write_json(const string & json_name, const string & input_xml_name, const string & output_db_name, unsigned int num_threads) const {
+	ofstream json_file(json_name.c_str());
+	if (!json_file) {
+		cerr << "Error: could not open " << json_name << " for writing." << endl;
+		exit(1);
+	}
+	chrono::duration<double> wall_diff = chrono::high_resolution_clock::now() - run_wall_start;
+	json_file << "{" << endl;
+	json_file << "\t\"input_xml\": " << json_string(input_xml_name) << "," << endl;
+	json_file << "\t\"output_db\": " << json_string(output_db_name) << "," << endl;
+	json_file << "\t\"threads\": " << num_threads << "," << endl;
+	json_file << "\t\"wall_seconds\": " << wall_diff.count() << "," << endl;
+	json_file << "\t\"cpu_seconds\": " << (get_cpu_time() - run_cpu_start) << "," << endl;
+	json_file << "\t\"peak_rss_kb\": " << get_peak_memory_usage() << "," << endl;
+	json_file << "\t\"phases\": [";
+	for (size_t i = 0; i < phases.size(); i++) {
+		const phase_stats & stats = phases[i];
+		json_file << (i > 0 ? "," : "") << endl;
+		json_file << "\t\t{";
+		json_file << "\"name\": " << json_string(stats.name) << ", ";
+		json_file << "\"wall_seconds\": " << stats.wall_seconds << ", ";
+		json_file << "\"cpu_seconds\": " << stats.cpu_seconds << ", ";
+		json_file << "\"rows\": " << stats.rows << ", ";
+		json_file << "\"blob_bytes\": " << stats.blob_bytes << ", ";
+		json_file << "\"peak_rss_kb\": " << stats.peak_rss_kb;
+		json_file << "}";
+	}
+	json_file << endl << "\t]" << endl;
+	json_file << "}" << endl;
+	return;
+}
+
+/**
+ * Read-only view of the raw contents of an input file, backed by a memory mapping.
+ */
+struct input_buffer {
+	const char * data;
+	size_t size;
+	size_t released; //offset up to which the mapped pages have been handed back to the operating system
+	#ifdef _WIN32
+		HANDLE file_handle;
+		HANDLE mapping_handle;
+	#endif
+};
+
+/**
+ * Memory-maps the file with the given name into the given input buffer.
+ * The return value will be true if successful, and false otherwise.
+ */
+bool map_input_file(const string & filename, input_buffer & buf) {
+	buf.data = NULL;
+	buf.size = 0;
+	buf.released = 0;
+	#ifdef _WIN32
+		buf.file_handle = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+		if (buf.file_handle == INVALID_HANDLE_VALUE) {
+			return false;
+		}
+		LARGE_INTEGER file_size;
+		if (!GetFileSizeEx(buf.file_handle, & file_size) || file_size.QuadPart == 0) {
+			CloseHandle(buf.file_handle);
+			return false;
+		}
+		buf.mapping_handle = CreateFileMappingA(buf.file_handle, NULL, PAGE_READONLY, 0, 0, NULL);
+		if (buf.mapping_handle == NULL) {
+			CloseHandle(buf.file_handle);
+			return false;
+		}
+		buf.data = reinterpret_cast<const char *>(MapViewOfFile(buf.mapping_handle, FILE_MAP_READ, 0, 0, 0));
+		if (buf.data == NULL) {
+			CloseHandle(buf.mapping_handle);
+			CloseHandle(buf.file_handle);
+			return false;
+		}
+		buf.size = (size_t) file_size.QuadPart;
+	#else
+		int fd = open(filename.c_str(), O_RDONLY);
+		if (fd < 0) {
+			return false;
+		}
+		struct stat st;
+		if (fstat(fd, & st) != 0 || st.st_size == 0) {
+			close(fd);
+			return false;
+		}
+		void * addr = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		//The mapping remains valid after the file descriptor is closed:
+		close(fd);
+		if (addr == MAP_FAILED) {
+			return false;
+		}
+		//We will only ever scan the file forward:
+		madvise(addr, (size_t) st.st_size, MADV_SEQUENTIAL);
+		buf.data = reinterpret_cast<const char *>(addr);
+		buf.size = (size_t) st.st_size;
+	#endif
+	return true;
+}
+
+/**
+ * Hands the pages of the given input buffer that lie entirely before the given offset back to the operating system,
+ * so that raw XML that has already been parsed does not count against resident memory.
+ * On platforms where this is not supported, this does nothing.
+ */
+void release_input_buffer(input_buffer & buf, size_t offset) {
+	#ifndef _WIN32
+		size_t page_size = (size_t) sysconf(_SC_PAGESIZE);
+		size_t end = (offset / page_size) * page_size;
+		if (end > buf.released) {
+			madvise(const_cast<char *>(buf.data) + buf.released, end - buf.released, MADV_DONTNEED);
+			buf.released = end;
+		}
+	#endif
+	return;
+}
+
+/**
+ * Unmaps the given input buffer.
+ */
+void unmap_input_file(input_buffer & buf) {
+	if (buf.data == NULL) {
+		return;
+	}
+	#ifdef _WIN32
+		UnmapViewOfFile(buf.data);
+		CloseHandle(buf.mapping_handle);
+		CloseHandle(buf.file_handle);
+	#else
+		munmap(const_cast<char *>(buf.data), buf.size);
+	#endif
+	buf.data = NULL;
+	buf.size = 0;
+	return;
+}
+
+/**
+ * Checks whether the given input buffer contains markup that the tag scanner of stream_apparatus() cannot handle:
+ * a document type declaration (which may declare entities whose replacement text contains markup) or a CDATA section.
+ * If it does, then the given string is set to a description of the first such markup, and true is returned.
+ */
+bool has_unsupported_markup(const input_buffer & buf, string & markup) {
+	size_t pos = 0;
+	while (pos < buf.size) {
+		const char * lt = reinterpret_cast<const char *>(memchr(buf.data + pos, '<', buf.size - pos));
+		if (lt == NULL) {
+			break;
+		}
+		pos = lt - buf.data;
+		size_t remaining = buf.size - pos;
+		if (remaining >= 9 && strncmp(lt, "<!DOCTYPE", 9) == 0) {
+			markup = "a document type declaration";
+			return true;
+		}
+		if (remaining >= 9 && strncmp(lt, "<![CDATA[", 9) == 0) {
+			markup = "a CDATA section";
+			return true;
+		}
+		pos++;
+	}
+	return false;
+}
+
+/**
+ * Returns the offset of the first start tag (if closing is false) or end tag (if closing is true) for elements with the given name
+ * at or after the given offset in the input buffer.
+ * Comments and processing instructions are skipped; the buffer must not contain any markup rejected by has_unsupported_markup().
+ * If no such tag is found, then the size of the buffer is returned.
+ */
+size_t find_tag(const input_buffer & buf, size_t pos, const string & name, bool closing) {
+	string prefix = closing ? "</" + name : "<" + name;
+	while (pos < buf.size) {
+		const char * lt = reinterpret_cast<const char *>(memchr(buf.data + pos, '<', buf.size - pos));
+		if (lt == NULL) {
+			return buf.size;
+		}
+		pos = lt - buf.data;
+		size_t remaining = buf.size - pos;
+		//Skip over any markup that may contain unparsed text:
+		const char * skip_end = NULL;
+		if (remaining >= 4 && strncmp(lt, "<!--", 4) == 0) {
+			skip_end = "-->";
+		}
+		else if (remaining >= 2 && lt[1] == '?') {
+			skip_end = "?>";
+		}
+		if (skip_end != NULL) {
+			size_t skip_end_len = strlen(skip_end);
+			size_t end_pos = pos + 2;
+			while (end_pos + skip_end_len <= buf.size && strncmp(buf.data + end_pos, skip_end, skip_end_len) != 0) {
+				end_pos++;
+			}
+			pos = end_pos + skip_end_len;
+			continue;
+		}
+		//Otherwise, check if this is the tag we are looking for (and not merely a tag whose name starts with the same characters):
+		if (remaining > prefix.size() && strncmp(lt, prefix.c_str(), prefix.size()) == 0) {
+			char next = lt[prefix.size()];
+			if (next == '>' || next == '/' || isspace((unsigned char) next)) {
+				return pos;
+			}
+		}
+		pos++;
+	}
+	return buf.size;
+}
+
+/**
+ * Given the offset of a start tag for an element with the given name in the input buffer,
+ * returns the offset just past the end of that element, accounting for nested elements with the same name.
+ * If the element is not closed, then the size of the buffer is returned.
+ */
+size_t find_element_end(const input_buffer & buf, size_t start, const string & name) {
+	int depth = 0;
+	size_t pos = start;
+	while (pos < buf.size) {
+		size_t next_start_tag = find_tag(buf, pos, name, false);
+		size_t next_end_tag = find_tag(buf, pos, name, true);
+		size_t next_tag = min(next_start_tag, next_end_tag);
+		if (next_tag >= buf.size) {
+			break;
+		}
+		const char * gt = reinterpret_cast<const char *>(memchr(buf.data + next_tag, '>', buf.size - next_tag));
+		if (gt == NULL) {
+			break;
+		}
+		size_t tag_end = (gt - buf.data) + 1;
+		if (next_tag == next_start_tag) {
+			//Self-closing elements do not change the nesting depth:
+			if (*(gt - 1) != '/') {
+				depth++;
+			}
+		}
+		else {
+			depth--;
+		}
+		if (depth == 0) {
+			return tag_end;
+		}
+		pos = tag_end;
+	}
+	return buf.size;
+}
+
+/**
+ * Parses the given input XML file into an apparatus in the usual way,
+ * loading the entire document before processing it.
+ * The document is released as soon as the apparatus has been constructed.
+ */
+apparatus load_apparatus(const string & input_xml_name, bool merge_splits, const set<string> & trivial_reading_types, const set<string> & dropped_reading_types, const list<string> & ignored_suffixes, stats_report & stats) {
+	stats.begin_phase("xml_parse");
+	xml_document doc;
+	xml_parse_result pr = doc.load_file(input_xml_name.c_str());
+	if (!pr) {
+		cerr << "Error: An error occurred while loading XML file " << input_xml_name << ": " << pr.description() << endl;
+		exit(1);
+	}
+	xml_node tei_node = doc.child("TEI");
+	if (!tei_node) {
+		cerr << "Error: The XML file " << input_xml_name << " does not have a <TEI> element as its root element." << endl;
+		exit(1);
+	}
+	stats.end_phase();
+	stats.begin_phase("apparatus_construction");
+	apparatus app = apparatus(tei_node, merge_splits, trivial_reading_types, dropped_reading_types, ignored_suffixes);
+	stats.end_phase();
+	return app;
+}
+
+/**
+ * Parses the given input XML file into an apparatus one <app> element at a time.
+ * The file is memory-mapped, and only the <listWit> element (parsed once, for the witness list) or a single <app> element is held in a parsed document at any time;
+ * each <app> element is converted directly to a variation unit with the same processing options as the full apparatus,
+ * and the pages of raw XML preceding it are released once it has been parsed.
+ * Since a variation unit's ID and label may be derived from the attributes of the <ab> element enclosing its <app> element,
+ * each <app> element is parsed inside a copy of the start tag of its enclosing <ab> element, if it has one.
+ * The elements are found by a lightweight tag scanner rather than a full XML parser,
+ * so files with a document type declaration or CDATA sections are rejected with an error; they can still be parsed without streaming.
+ */
+apparatus stream_apparatus(const string & input_xml_name, bool merge_splits, const set<string> & trivial_reading_types, const set<string> & dropped_reading_types, const list<string> & ignored_suffixes, stats_report & stats) {
+	stats.begin_phase("xml_parse");
+	input_buffer buf;
+	if (!map_input_file(input_xml_name, buf)) {
+		cerr << "Error: An error occurred while mapping XML file " << input_xml_name << " into memory." << endl;
+		exit(1);
+	}
+	string markup;
+	if (has_unsupported_markup(buf, markup)) {
+		cerr << "Error: The XML file " << input_xml_name << " contains " << markup << ", which cannot be parsed with the --stream option; please run populate_db without it." << endl;
+		unmap_input_file(buf);
+		exit(1);
+	}
+	if (find_tag(buf, 0, "TEI", false) >= buf.size) {
+		cerr << "Error: The XML file " << input_xml_name << " does not have a <TEI> element as its root element." << endl;
+		unmap_input_file(buf);
+		exit(1);
+	}
+	//Parse the witness list once:
+	size_t list_wit_start = find_tag(buf, 0, "listWit", false);
+	size_t list_wit_end = list_wit_start < buf.size ? find_element_end(buf, list_wit_start, "listWit") : buf.size;
+	if (list_wit_end >= buf.size) {
+		cerr << "Error: The XML file " << input_xml_name << " does not have a complete <listWit> element." << endl;
+		unmap_input_file(buf);
+		exit(1);
+	}
+	string skeleton = "<TEI>" + string(buf.data + list_wit_start, list_wit_end - list_wit_start) + "</TEI>";
+	xml_document skeleton_doc;
+	xml_parse_result pr = skeleton_doc.load_buffer(skeleton.c_str(), skeleton.size());
+	if (!pr) {
+		cerr << "Error: An error occurred while parsing the <listWit> element of XML file " << input_xml_name << ": " << pr.description() << endl;
+		unmap_input_file(buf);
+		exit(1);
+	}
+	list<string> list_wit = apparatus(skeleton_doc.child("TEI"), merge_splits, trivial_reading_types, dropped_reading_types, ignored_suffixes).get_list_wit();
+	skeleton_doc.reset();
+	//Then process each <app> element in document order:
+	vector<variation_unit> variation_units = vector<variation_unit>();
+	string ab_start_tag = string(); //start tag of the last <ab> element to begin before the current <app> element
+	size_t ab_end = 0; //offset just past the end of that <ab> element
+	size_t next_ab_pos = find_tag(buf, 0, "ab", false);
+	size_t pos = find_tag(buf, 0, "app", false);
+	while (pos < buf.size) {
+		size_t app_end = find_element_end(buf, pos, "app");
+		if (app_end >= buf.size) {
+			cerr << "Error: The XML file " << input_xml_name << " has an unclosed <app> element at byte offset " << pos << "." << endl;
+			unmap_input_file(buf);
+			exit(1);
+		}
+		//Advance to the last <ab> element that begins before this <app> element:
+		while (next_ab_pos < pos) {
+			const char * gt = reinterpret_cast<const char *>(memchr(buf.data + next_ab_pos, '>', buf.size - next_ab_pos));
+			if (gt == NULL) {
+				break;
+			}
+			size_t ab_tag_end = (gt - buf.data) + 1;
+			//A self-closing <ab> element cannot enclose anything:
+			ab_start_tag = *(gt - 1) != '/' ? string(buf.data + next_ab_pos, ab_tag_end - next_ab_pos) : string();
+			ab_end = find_element_end(buf, next_ab_pos, "ab");
+			next_ab_pos = find_tag(buf, ab_tag_end, "ab", false);
+		}
+		//If that <ab> element encloses this <app> element, then parse the <app> element inside a copy of its start tag:
+		string app_xml = string(buf.data + pos, app_end - pos);
+		bool enclosed = !ab_start_tag.empty() && pos < ab_end;
+		if (enclosed) {
+			app_xml = ab_start_tag + app_xml + "</ab>";
+		}
+		xml_document app_doc;
+		pr = app_doc.load_buffer(app_xml.c_str(), app_xml.size());
+		if (!pr) {
+			cerr << "Error: An error occurred while parsing the <app> element at byte offset " << pos << " of XML file " << input_xml_name << ": " << pr.description() << endl;
+			unmap_input_file(buf);
+			exit(1);
+		}
+		//Construct the variation unit for this element, which can look up its enclosing <ab> element as its parent:
+		xml_node app_node = enclosed ? app_doc.first_child().child("app") : app_doc.child("app");
+		stats.end_phase();
+		stats.begin_phase("apparatus_construction");
+		variation_units.push_back(variation_unit(app_node, merge_splits, trivial_reading_types, dropped_reading_types, ignored_suffixes));
+		stats.end_phase();
+		stats.begin_phase("xml_parse");
+		app_doc.reset();
+		//Release the raw XML that we are done with and move on to the next <app> element:
+		release_input_buffer(buf, app_end);
+		pos = find_tag(buf, app_end, "app", false);
+	}
+	unmap_input_file(buf);
+	stats.end_phase();
+	stats.begin_phase("apparatus_construction");
+	//The apparatus constructor copies the variation units (it takes them by constant reference), so both copies are briefly held at once;
+	//free ours as soon as the apparatus has been made:
+	apparatus app = apparatus(list_wit, variation_units);
+	vector<variation_unit>().swap(variation_units);
+	stats.end_phase();
+	return app;
+}
+
+/**
+ * Returns the number of variation units at which each witness in the given apparatus's witness list is extant, keyed by witness ID.
+ * The counts for all witnesses are accumulated in a single pass over the variation units' reading support,
+ * rather than by scanning every variation unit once per witness.
+ */
+unordered_map<string, int> get_extant_counts(const apparatus & app) {
+	unordered_map<string, int> extant_counts = unordered_map<string, int>();
+	for (const string & wit_id : app.get_list_wit()) {
+		extant_counts[wit_id] = 0;
+	}
+	for (const variation_unit & vu : app.get_variation_units()) {
+		for (const pair<const string, string> & kv : vu.get_reading_support()) {
+			unordered_map<string, int>::iterator it = extant_counts.find(kv.first);
+			if (it != extant_counts.end()) {
+				it->second++;
+			}
+		}
+	}
+	return extant_counts;
+}
+
+/**
+ * Groups the witnesses in the given engine's witness list whose readings are identical at every variation unit (including the units at which they are lacunose),
+ * since their genealogical comparisons with every witness are identical as well.
+ * Returns a map from the first witness of each group with more than one member to the other members of its group, in witness list order.
+ * Each witness's row of the engine's reading matrix is hashed, and witnesses with equal hashes are then compared row against row.
+ */
+unordered_map<string, list<string>> get_duplicate_witnesses(const comparison_engine & engine) {
+	vector<string> list_wit = engine.get_list_wit();
+	unsigned int num_units = engine.get_num_units();
+	unordered_map<string, list<string>> duplicates = unordered_map<string, list<string>>();
+	//Map the hash of each distinct row to the indices of the first witnesses with that hash:
+	unordered_map<uint64_t, list<unsigned int>> first_wit_inds = unordered_map<uint64_t, list<unsigned int>>();
+	for (unsigned int wit_ind = 0; wit_ind < (unsigned int) list_wit.size(); wit_ind++) {
+		//Hash the witness's reading codes with 64-bit FNV-1a:
+		uint64_t hash = 14695981039346656037ULL;
+		for (unsigned int vu_ind = 0; vu_ind < num_units; vu_ind++) {
+			hash ^= (uint64_t) (engine.get_reading_code(vu_ind, wit_ind) + 1);
+			hash *= 1099511628211ULL;
+		}
+		list<unsigned int> & candidates = first_wit_inds[hash];
+		bool found = false;
+		for (unsigned int first_wit_ind : candidates) {
+			if (engine.same_readings(first_wit_ind, wit_ind)) {
+				duplicates[list_wit[first_wit_ind]].push_back(list_wit[wit_ind]);
+				found = true;
+				break;
+			}
+		}
+		if (!found) {
+			candidates.push_back(wit_ind);
+		}
+	}
+	return duplicates;
+}
+
+/**
+ * Schemas in which the genealogical comparisons can be stored.
+ * The full schema stores a row for every ordered pair of witnesses in the GENEALOGICAL_COMPARISONS table;
+ * the compact schema stores a row for every unordered pair in the GENEALOGICAL_COMPARISON_PAIRS table (see create_compact_genealogical_comparisons_table());
+ * and the clustered schema stores a row for every ordered pair in the GENEALOGICAL_COMPARISONS_CLUSTERED table, keyed by witness ordinals (see create_clustered_genealogical_comparisons_table()).
+ * The read scripts present the latter two schemas in the form of the first; see attach_comparisons_view().
+ */
+enum comparison_schema {FULL_SCHEMA, COMPACT_SCHEMA, CLUSTERED_SCHEMA};
+
+/**
+ * Returns the name of the table in which the genealogical comparisons are stored under the given schema.
+ */
+string get_comparisons_table_name(comparison_schema schema) {
+	switch (schema) {
+		case COMPACT_SCHEMA:
+			return "GENEALOGICAL_COMPARISON_PAIRS";
+		case CLUSTERED_SCHEMA:
+			return "GENEALOGICAL_COMPARISONS_CLUSTERED";
+		default:
+			return "GENEALOGICAL_COMPARISONS";
+	}
+}
+
+/**
+ * Creates the index on the table with the given name in the genealogical cache, replacing any existing index of the same name.
+ */
+void create_table_index(sqlite3 * output_db, const string & table_name) {
+	//Each table in the cache has a single index, named after the table,
+	//except for the table of the compact schema, which also needs an index on its secondary witnesses in order to look up mirrored comparisons.
+	//The index of the GENEALOGICAL_COMPARISONS table also covers the relationship counts and costs,
+	//so that they can be listed for a primary witness from the index alone, without reading any rows of the table:
+	static const unordered_map<string, string> indexed_columns = {
+		{"READINGS", "VARIATION_UNIT, READING"},
+		{"READING_RELATIONS", "VARIATION_UNIT, PRIOR, POSTERIOR"},
+		{"READING_SUPPORT", "VARIATION_UNIT, WITNESS, READING"},
+		{"VARIATION_UNITS", "VARIATION_UNIT"},
+		{"GENEALOGICAL_COMPARISONS", "PRIMARY_WIT, SECONDARY_WIT, ROW_ID, EXTANT_COUNT, AGREEMENTS_COUNT, PRIOR_COUNT, POSTERIOR_COUNT, NOREL_COUNT, UNCLEAR_COUNT, EXPLAINED_COUNT, COST"},
+		{"GENEALOGICAL_COMPARISON_PAIRS", "PRIMARY_WIT, SECONDARY_WIT"},
+		{"WITNESSES", "WITNESS"}
+	};
+	int rc; //to store SQLite macros
+	string idx_name = table_name + "_IDX";
+	string create_idx_sql = "DROP INDEX IF EXISTS " + idx_name + ";"
+			"CREATE INDEX " + idx_name + " ON " + table_name + " (" + indexed_columns.at(table_name) + ");";
+	if (table_name == "GENEALOGICAL_COMPARISON_PAIRS") {
+		create_idx_sql += "DROP INDEX IF EXISTS " + table_name + "_MIRROR_IDX;"
+				"CREATE INDEX " + table_name + "_MIRROR_IDX ON " + table_name + " (SECONDARY_WIT, PRIMARY_WIT);";
+	}
+	char * create_idx_error_msg;
+	rc = sqlite3_exec(output_db, create_idx_sql.c_str(), NULL, 0, & create_idx_error_msg);
+	if (rc != SQLITE_OK) {
+		cerr << "Error creating index " << idx_name << ": " << create_idx_error_msg << endl;
+		sqlite3_free(create_idx_error_msg);
+		exit(1);
+	}
+	return;
+}
+
+/**
+ * Executes the given SQL statements on the given database, exiting with an error if they fail.
+ * This is used for the statements that begin and end transactions, whose failure would otherwise go unnoticed.
+ */
+void execute_sql(sqlite3 * output_db, const string & sql) {
+	char * error_msg;
+	int rc = sqlite3_exec(output_db, sql.c_str(), NULL, NULL, & error_msg);
+	if (rc != SQLITE_OK) {
+		cerr << "Error executing SQL statement \"" << sql << "\": " << error_msg << endl;
+		sqlite3_free(error_msg);
+		exit(1);
+	}
+	return;
+}
+
+/**
+ * Prints the given message followed by the number of seconds elapsed since the given start time.
+ */
+void print_elapsed_time(const string & msg, const chrono::high_resolution_clock::time_point & start) {
+	chrono::duration<double> diff = chrono::high_resolution_clock::now() - start;
+	cout << msg << diff.count() << " seconds" << endl;
+	return;
+}
+
+/**
+ * Configures the given newly created database for bulk loading.
+ * Larger pages and a larger page cache reduce the number of page writes for the cache's large BLOB rows,
+ * and journaling and syncing are turned off entirely, since the database is being built in a temporary file
+ * that only replaces the output database once it is complete (see replace_file()).
+ * The page size must be set before any tables are created in order to take effect.
+ */
+void configure_bulk_load(sqlite3 * output_db) {
+	int rc; //to store SQLite macros
+	string bulk_load_sql = "PRAGMA page_size = 65536;"
+			"PRAGMA cache_size = -262144;" //in KiB, i.e., 256 MiB
+			"PRAGMA journal_mode = OFF;"
+			"PRAGMA synchronous = OFF;"
+			"PRAGMA locking_mode = EXCLUSIVE;"
+			"PRAGMA temp_store = MEMORY;";
+	char * bulk_load_error_msg;
+	rc = sqlite3_exec(output_db, bulk_load_sql.c_str(), NULL, 0, & bulk_load_error_msg);
+	if (rc != SQLITE_OK) {
+		cerr << "Error configuring database for bulk loading: " << bulk_load_error_msg << endl;
+		sqlite3_free(bulk_load_error_msg);
+		exit(1);
+	}
+	return;
+}
+
+/**
+ * Creates the indexes that were deferred while the tables of the genealogical cache were being populated,
+ * and then gathers statistics on them for the query planner.
+ * The genealogical comparisons are in the table of the given schema; the table of the clustered schema needs no index besides its primary key.
+ * Building each index once over a fully populated table is much faster than updating it after every insertion.
+ */
+void create_deferred_indexes(sqlite3 * output_db, comparison_schema schema) {
+	vector<string> table_names = {"READINGS", "READING_RELATIONS", "READING_SUPPORT", "VARIATION_UNITS", "WITNESSES"};
+	if (schema != CLUSTERED_SCHEMA) {
+		table_names.push_back(get_comparisons_table_name(schema));
+	}
+	for (const string & table_name : table_names) {
+		cout << "Indexing table " << table_name << "..." << endl;
+		auto start = chrono::high_resolution_clock::now();
+		create_table_index(output_db, table_name);
+		print_elapsed_time("Time taken to index table " + table_name + ": ", start);
+	}
+	cout << "Analyzing database..." << endl;
+	auto start = chrono::high_resolution_clock::now();
+	char * analyze_error_msg;
+	int rc = sqlite3_exec(output_db, "ANALYZE", NULL, 0, & analyze_error_msg);
+	if (rc != SQLITE_OK) {
+		cerr << "Error analyzing database: " << analyze_error_msg << endl;
+		sqlite3_free(analyze_error_msg);
+		exit(1);
+	}
+	print_elapsed_time("Time taken to analyze database: ", start);
+	return;
+}
+
+/**
+ * Replaces the file at the given destination path with the file at the given source path in a single step,
+ * so that the destination is never left partially written.
+ * Returns true if the replacement succeeded.
+ */
+bool replace_file(const string & src_name, const string & dest_name) {
+	#ifdef _WIN32
+		return MoveFileExA(src_name.c_str(), dest_name.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+	#else
+		return rename(src_name.c_str(), dest_name.c_str()) == 0;
+	#endif
+}
+
 /**
  * Creates, indexes, and populates the READINGS table.
+ * If the defer_index flag is set, then the table is not indexed; see create_deferred_indexes().
  */
-void populate_readings_table(sqlite3 * output_db, const apparatus & app) {
+void populate_readings_table(sqlite3 * output_db, const apparatus & app, bool defer_index) {
 	int rc; //to store SQLite macros
 	//Create the READINGS table:
 	string create_readings_sql = "DROP TABLE IF EXISTS READINGS;"
@@ -51,15 +836,9 @@ void populate_readings_table(sqlite3 * output_db, const apparatus & app) {
 		sqlite3_free(create_readings_error_msg);
 		exit(1);
 	}
-	//Denormalize it:
-	string create_readings_idx_sql = "DROP INDEX IF EXISTS READINGS_IDX;"
-			"CREATE INDEX READINGS_IDX ON READINGS (VARIATION_UNIT, READING);";
-	char * create_readings_idx_error_msg;
-	rc = sqlite3_exec(output_db, create_readings_idx_sql.c_str(), NULL, 0, & create_readings_idx_error_msg);
-	if (rc != SQLITE_OK) {
-		cerr << "Error creating index READINGS_IDX: " << create_readings_idx_error_msg << endl;
-		sqlite3_free(create_readings_idx_error_msg);
-		exit(1);
+	//Denormalize it (unless indexing has been deferred until after the table is populated):
+	if (!defer_index) {
+		create_table_index(output_db, "READINGS");
 	}
 	//Then populate it using prepared statements within a single transaction:
 	char * transaction_error_msg;
@@ -96,8 +875,9 @@ void populate_readings_table(sqlite3 * output_db, const apparatus & app) {
 
 /**
  * Creates, indexes, and populates the READING_RELATIONS table.
+ * If the defer_index flag is set, then the table is not indexed; see create_deferred_indexes().
  */
-void populate_reading_relations_table(sqlite3 * output_db, const apparatus & app) {
+void populate_reading_relations_table(sqlite3 * output_db, const apparatus & app, bool defer_index) {
 	int rc; //to store SQLite macros
 	//Create the READING_RELATIONS table:
 	string create_reading_relations_sql = "DROP TABLE IF EXISTS READING_RELATIONS;"
@@ -114,15 +894,9 @@ void populate_reading_relations_table(sqlite3 * output_db, const apparatus & app
 		sqlite3_free(create_reading_relations_error_msg);
 		exit(1);
 	}
-	//Denormalize it:
-	string create_reading_relations_idx_sql = "DROP INDEX IF EXISTS READING_RELATIONS_IDX;"
-			"CREATE INDEX READING_RELATIONS_IDX ON READING_RELATIONS (VARIATION_UNIT, PRIOR, POSTERIOR);";
-	char * create_reading_relations_idx_error_msg;
-	rc = sqlite3_exec(output_db, create_reading_relations_idx_sql.c_str(), NULL, 0, & create_reading_relations_idx_error_msg);
-	if (rc != SQLITE_OK) {
-		cerr << "Error creating index READING_RELATIONS_IDX: " << create_reading_relations_idx_error_msg << endl;
-		sqlite3_free(create_reading_relations_idx_error_msg);
-		exit(1);
+	//Denormalize it (unless indexing has been deferred until after the table is populated):
+	if (!defer_index) {
+		create_table_index(output_db, "READING_RELATIONS");
 	}
 	//Then populate it using prepared statements within a single transaction:
 	char * transaction_error_msg;
@@ -162,10 +936,12 @@ void populate_reading_relations_table(sqlite3 * output_db, const apparatus & app
 
 /**
  * Creates, indexes, and populates the READING_SUPPORT table.
+ * If the defer_index flag is set, then the table is not indexed; see create_deferred_indexes().
  * Rows will be populated in order of variation unit, then witness ID, 
- * following the order of witness IDs in the apparatus's list_wit member.
+ * following the order of witness IDs in the given engine's witness list.
+ * Each witness's reading is read from the engine's reading matrix, so no reading support maps are copied or searched.
  */
-void populate_reading_support_table(sqlite3 * output_db, const apparatus & app) {
+void populate_reading_support_table(sqlite3 * output_db, const comparison_engine & engine, bool defer_index) {
 	int rc; //to store SQLite macros
 	//Create the READING_SUPPORT table:
 	string create_reading_support_sql = "DROP TABLE IF EXISTS READING_SUPPORT;"
@@ -181,15 +957,9 @@ void populate_reading_support_table(sqlite3 * output_db, const apparatus & app)
 		sqlite3_free(create_reading_support_error_msg);
 		exit(1);
 	}
-	//Denormalize it:
-	string create_reading_support_idx_sql = "DROP INDEX IF EXISTS READING_SUPPORT_IDX;"
-			"CREATE INDEX READING_SUPPORT_IDX ON READING_SUPPORT (VARIATION_UNIT, WITNESS, READING);";
-	char * create_reading_support_idx_error_msg;
-	rc = sqlite3_exec(output_db, create_reading_support_idx_sql.c_str(), NULL, 0, & create_reading_support_idx_error_msg);
-	if (rc != SQLITE_OK) {
-		cerr << "Error creating index READING_SUPPORT_IDX: " << create_reading_support_idx_error_msg << endl;
-		sqlite3_free(create_reading_support_idx_error_msg);
-		exit(1);
+	//Denormalize it (unless indexing has been deferred until after the table is populated):
+	if (!defer_index) {
+		create_table_index(output_db, "READING_SUPPORT");
 	}
 	//Then populate it using prepared statements within a single transaction:
 	char * transaction_error_msg;
@@ -201,20 +971,21 @@ void populate_reading_support_table(sqlite3 * output_db, const apparatus & app)
 		exit(1);
 	}
 	int row_id = 0;
-	for (variation_unit vu : app.get_variation_units()) {
-		string vu_id = vu.get_id();
-		unordered_map<string, string> reading_support = vu.get_reading_support();
-		for (string wit_id : app.get_list_wit()) {
+	vector<string> list_wit = engine.get_list_wit();
+	for (unsigned int vu_ind = 0; vu_ind < engine.get_num_units(); vu_ind++) {
+		const string & vu_id = engine.get_unit_id(vu_ind);
+		const vector<string> & readings = engine.get_unit_readings(vu_ind);
+		for (unsigned int wit_ind = 0; wit_ind < (unsigned int) list_wit.size(); wit_ind++) {
 			//Skip any witnesses that are lacunose here:
-			if (reading_support.find(wit_id) == reading_support.end()) {
+			int rdg_code = engine.get_reading_code(vu_ind, wit_ind);
+			if (rdg_code < 0) {
 				continue;
 			}
-			string wit_rdg = reading_support.at(wit_id);
 			//Then insert a row containing these values:
 			sqlite3_bind_int(insert_into_reading_support_stmt, 1, row_id);
 			sqlite3_bind_text(insert_into_reading_support_stmt, 2, vu_id.c_str(), -1, SQLITE_STATIC);
-			sqlite3_bind_text(insert_into_reading_support_stmt, 3, wit_id.c_str(), -1, SQLITE_STATIC);
-			sqlite3_bind_text(insert_into_reading_support_stmt, 4, wit_rdg.c_str(), -1, SQLITE_STATIC);
+			sqlite3_bind_text(insert_into_reading_support_stmt, 3, list_wit[wit_ind].c_str(), -1, SQLITE_STATIC);
+			sqlite3_bind_text(insert_into_reading_support_stmt, 4, readings[rdg_code].c_str(), -1, SQLITE_STATIC);
 			rc = sqlite3_step(insert_into_reading_support_stmt);
 			if (rc != SQLITE_DONE) {
 				cerr << "Error executing prepared statement." << endl;
@@ -230,10 +1001,46 @@ void populate_reading_support_table(sqlite3 * output_db, const apparatus & app)
 	return;
 }
 
+/**
+ * Returns a hexadecimal content hash of the given variation unit, covering its ID, label, connectivity, readings,
+ * the readings of the witnesses in the given witness list, and the edges and weights of its local stemma.
+ * The hash is stored in the VARIATION_UNITS table so that an update can detect which units have changed.
+ * It is a 64-bit FNV-1a hash of a canonical serialization of these fields, which is stable across platforms and runs.
+ */
+string get_variation_unit_hash(const variation_unit & vu, const list<string> & list_wit) {
+	//Serialize the unit's contents, separating fields with a character that cannot appear in XML content:
+	const char sep = '\x1f';
+	stringstream ss;
+	ss << vu.get_id() << sep << vu.get_label() << sep << vu.get_connectivity() << sep;
+	for (const string & rdg : vu.get_readings()) {
+		ss << rdg << sep;
+	}
+	unordered_map<string, string> reading_support = vu.get_reading_support();
+	for (const string & wit_id : list_wit) {
+		if (reading_support.find(wit_id) != reading_support.end()) {
+			ss << wit_id << '=' << reading_support.at(wit_id) << sep;
+		}
+	}
+	ss.precision(9); //enough digits to distinguish any two floats
+	for (const local_stemma_edge & e : vu.get_local_stemma().get_edges()) {
+		ss << e.prior << '>' << e.posterior << ':' << e.weight << sep;
+	}
+	//Then hash the serialization:
+	uint64_t hash = 14695981039346656037ULL;
+	for (unsigned char c : ss.str()) {
+		hash ^= c;
+		hash *= 1099511628211ULL;
+	}
+	char hex[17];
+	snprintf(hex, sizeof(hex), "%016llx", (unsigned long long) hash);
+	return string(hex);
+}
+
 /**
  * Creates, indexes, and populates the VARIATION_UNITS table.
+ * If the defer_index flag is set, then the table is not indexed; see create_deferred_indexes().
  */
-void populate_variation_units_table(sqlite3 * output_db, const apparatus & app) {
+void populate_variation_units_table(sqlite3 * output_db, const apparatus & app, bool defer_index) {
 	int rc; //to store SQLite macros
 	//Create the VARIATION_UNITS table:
 	string create_variation_units_sql = "DROP TABLE IF EXISTS VARIATION_UNITS;"
@@ -241,7 +1048,8 @@ void populate_variation_units_table(sqlite3 * output_db, const apparatus & app)
 			"ROW_ID INT NOT NULL, "
 			"VARIATION_UNIT TEXT NOT NULL, "
 			"LABEL TEXT, "
-			"CONNECTIVITY INT NOT NULL);";
+			"CONNECTIVITY INT NOT NULL, "
+			"HASH TEXT NOT NULL);";
 	char * create_variation_units_error_msg;
 	rc = sqlite3_exec(output_db, create_variation_units_sql.c_str(), NULL, 0, & create_variation_units_error_msg);
 	if (rc != SQLITE_OK) {
@@ -249,35 +1057,32 @@ void populate_variation_units_table(sqlite3 * output_db, const apparatus & app)
 		sqlite3_free(create_variation_units_error_msg);
 		exit(1);
 	}
-	//Denormalize it:
-	string create_variation_units_idx_sql = "DROP INDEX IF EXISTS VARIATION_UNITS_IDX;"
-			"CREATE INDEX VARIATION_UNITS_IDX ON VARIATION_UNITS (VARIATION_UNIT);";
-	char * create_variation_units_idx_error_msg;
-	rc = sqlite3_exec(output_db, create_variation_units_idx_sql.c_str(), NULL, 0, & create_variation_units_idx_error_msg);
-	if (rc != SQLITE_OK) {
-		cerr << "Error creating index VARIATION_UNITS_IDX: " << create_variation_units_idx_error_msg << endl;
-		sqlite3_free(create_variation_units_idx_error_msg);
-		exit(1);
+	//Denormalize it (unless indexing has been deferred until after the table is populated):
+	if (!defer_index) {
+		create_table_index(output_db, "VARIATION_UNITS");
 	}
 	//Then populate it using prepared statements within a single transaction:
 	char * transaction_error_msg;
 	sqlite3_exec(output_db, "BEGIN TRANSACTION", NULL, NULL, & transaction_error_msg);
 	sqlite3_stmt * insert_into_variation_units_stmt;
-	rc = sqlite3_prepare(output_db, "INSERT INTO VARIATION_UNITS VALUES (?,?,?,?)", -1, & insert_into_variation_units_stmt, 0);
+	rc = sqlite3_prepare(output_db, "INSERT INTO VARIATION_UNITS VALUES (?,?,?,?,?)", -1, & insert_into_variation_units_stmt, 0);
 	if (rc != SQLITE_OK) {
 		cerr << "Error preparing statement." << endl;
 		exit(1);
 	}
+	list<string> list_wit = app.get_list_wit();
 	int row_id = 0;
 	for (variation_unit vu : app.get_variation_units()) {
 		string id = vu.get_id();
 		string label = vu.get_label();
 		int connectivity = vu.get_connectivity();
+		string hash = get_variation_unit_hash(vu, list_wit);
 		//Then insert a row containing these values:
 		sqlite3_bind_int(insert_into_variation_units_stmt, 1, row_id);
 		sqlite3_bind_text(insert_into_variation_units_stmt, 2, id.c_str(), -1, SQLITE_STATIC);
 		sqlite3_bind_text(insert_into_variation_units_stmt, 3, label.c_str(), -1, SQLITE_STATIC);
 		sqlite3_bind_int(insert_into_variation_units_stmt, 4, connectivity);
+		sqlite3_bind_text(insert_into_variation_units_stmt, 5, hash.c_str(), -1, SQLITE_STATIC);
 		rc = sqlite3_step(insert_into_variation_units_stmt);
 		if (rc != SQLITE_DONE) {
 			cerr << "Error executing prepared statement." << endl;
@@ -293,183 +1098,1695 @@ void populate_variation_units_table(sqlite3 * output_db, const apparatus & app)
 }
 
 /**
- * Creates, indexes, and populates the GENEALOGICAL_COMPARISONS table.
+ * Creates and indexes the GENEALOGICAL_COMPARISON_PAIRS table of the compact schema, dropping the tables of the other schemas.
+ * The compact schema stores one row for each unordered pair of witnesses (including each witness paired with itself),
+ * whose primary witness is the one that comes first in the witness list.
+ * Of the bitmaps of the comparison of the primary witness to the secondary witness, the NOREL bitmap is left out,
+ * since the AGREEMENTS, PRIOR, POSTERIOR, NOREL, and UNCLEAR bitmaps partition the EXTANT bitmap;
+ * of the mirrored comparison, only the EXPLAINED bitmap and the cost are stored,
+ * since its other bitmaps are the same as those of the primary comparison, with PRIOR and POSTERIOR swapped.
+ * The number of variation units in each bitmap (including the NOREL bitmap that is left out) is stored as in the full schema,
+ * along with the number in the mirrored EXPLAINED bitmap.
+ * Readers reconstruct the rows of the full schema with attach_comparisons_view().
+ * If the defer_index flag is set, then the table is not indexed; see create_deferred_indexes().
  */
-void populate_genealogical_comparisons_table(sqlite3 * output_db, const list<witness> & witnesses) {
+void create_compact_genealogical_comparisons_table(sqlite3 * output_db, bool defer_index) {
 	int rc; //to store SQLite macros
-	//Create the GENEALOGICAL_COMPARISONS table:
-	string create_genealogical_comparisons_sql = "DROP TABLE IF EXISTS GENEALOGICAL_COMPARISONS;"
-			"CREATE TABLE GENEALOGICAL_COMPARISONS ("
+	string create_genealogical_comparison_pairs_sql = "DROP TABLE IF EXISTS GENEALOGICAL_COMPARISONS;"
+			"DROP TABLE IF EXISTS GENEALOGICAL_COMPARISONS_CLUSTERED;"
+			"DROP TABLE IF EXISTS GENEALOGICAL_COMPARISON_PAIRS;"
+			"CREATE TABLE GENEALOGICAL_COMPARISON_PAIRS ("
 			"ROW_ID INT NOT NULL, "
 			"PRIMARY_WIT TEXT NOT NULL, "
 			"SECONDARY_WIT TEXT NOT NULL, "
+			"EXTANT_COUNT INTEGER NOT NULL, "
+			"AGREEMENTS_COUNT INTEGER NOT NULL, "
+			"PRIOR_COUNT INTEGER NOT NULL, "
+			"POSTERIOR_COUNT INTEGER NOT NULL, "
+			"NOREL_COUNT INTEGER NOT NULL, "
+			"UNCLEAR_COUNT INTEGER NOT NULL, "
+			"EXPLAINED_COUNT INTEGER NOT NULL, "
+			"MIRRORED_EXPLAINED_COUNT INTEGER NOT NULL, "
 			"EXTANT BLOB NOT NULL, "
 			"AGREEMENTS BLOB NOT NULL, "
 			"PRIOR BLOB NOT NULL, "
 			"POSTERIOR BLOB NOT NULL, "
-			"NOREL BLOB NOT NULL, "
 			"UNCLEAR BLOB NOT NULL, "
 			"EXPLAINED BLOB NOT NULL, "
-			"COST REAL NOT NULL);";
+			"MIRRORED_EXPLAINED BLOB NOT NULL, "
+			"COST REAL NOT NULL, "
+			"MIRRORED_COST REAL NOT NULL);";
+	char * create_genealogical_comparison_pairs_error_msg;
+	rc = sqlite3_exec(output_db, create_genealogical_comparison_pairs_sql.c_str(), NULL, 0, & create_genealogical_comparison_pairs_error_msg);
+	if (rc != SQLITE_OK) {
+		cerr << "Error creating table GENEALOGICAL_COMPARISON_PAIRS: " << create_genealogical_comparison_pairs_error_msg << endl;
+		sqlite3_free(create_genealogical_comparison_pairs_error_msg);
+		exit(1);
+	}
+	if (!defer_index) {
+		create_table_index(output_db, "GENEALOGICAL_COMPARISON_PAIRS");
+	}
+	return;
+}
+
+/**
+ * Creates the GENEALOGICAL_COMPARISONS_CLUSTERED table of the clustered schema, dropping the tables of the other schemas.
+ * The clustered schema stores the same columns as the full schema, except that the witnesses are identified by their ordinals
+ * (i.e., the ROW_ID values of their rows in the WITNESSES table) rather than their IDs,
+ * and the ordinals of the primary and secondary witnesses together form the primary key of a WITHOUT ROWID table.
+ * The rows of each primary witness are therefore stored contiguously and in witness list order, and can be read with a single range scan of the table
+ * instead of a lookup in a separate index for every row; this also makes the ROW_ID column and the separate index unnecessary.
+ */
+void create_clustered_genealogical_comparisons_table(sqlite3 * output_db) {
+	int rc; //to store SQLite macros
+	string create_genealogical_comparisons_clustered_sql = "DROP TABLE IF EXISTS GENEALOGICAL_COMPARISONS;"
+			"DROP TABLE IF EXISTS GENEALOGICAL_COMPARISON_PAIRS;"
+			"DROP TABLE IF EXISTS GENEALOGICAL_COMPARISONS_CLUSTERED;"
+			"CREATE TABLE GENEALOGICAL_COMPARISONS_CLUSTERED ("
+			"PRIMARY_WIT_ID INT NOT NULL, "
+			"SECONDARY_WIT_ID INT NOT NULL, "
+			"EXTANT_COUNT INTEGER NOT NULL, "
+			"AGREEMENTS_COUNT INTEGER NOT NULL, "
+			"PRIOR_COUNT INTEGER NOT NULL, "
+			"POSTERIOR_COUNT INTEGER NOT NULL, "
+			"NOREL_COUNT INTEGER NOT NULL, "
+			"UNCLEAR_COUNT INTEGER NOT NULL, "
+			"EXPLAINED_COUNT INTEGER NOT NULL, "
+			"EXTANT BLOB NOT NULL, "
+			"AGREEMENTS BLOB NOT NULL, "
+			"PRIOR BLOB NOT NULL, "
+			"POSTERIOR BLOB NOT NULL, "
+			"NOREL BLOB NOT NULL, "
+			"UNCLEAR BLOB NOT NULL, "
+			"EXPLAINED BLOB NOT NULL, "
+			"COST REAL NOT NULL, "
+			"PRIMARY KEY (PRIMARY_WIT_ID, SECONDARY_WIT_ID)) WITHOUT ROWID;";
+	char * create_genealogical_comparisons_clustered_error_msg;
+	rc = sqlite3_exec(output_db, create_genealogical_comparisons_clustered_sql.c_str(), NULL, 0, & create_genealogical_comparisons_clustered_error_msg);
+	if (rc != SQLITE_OK) {
+		cerr << "Error creating table GENEALOGICAL_COMPARISONS_CLUSTERED: " << create_genealogical_comparisons_clustered_error_msg << endl;
+		sqlite3_free(create_genealogical_comparisons_clustered_error_msg);
+		exit(1);
+	}
+	return;
+}
+
+/**
+ * Creates and indexes the table in which the genealogical comparisons are stored under the given schema.
+ * In every schema, the number of variation units in each bitmap is also stored in an INTEGER column,
+ * so that scripts that only need relationship counts do not have to read or decode any bitmaps;
+ * these columns come before the bitmaps, so that reading them does not touch the overflow pages that hold large bitmaps.
+ * The tables of the other schemas left by an earlier population of the database are dropped, so that readers do not find a stale table.
+ * If the defer_index flag is set, then the table is not indexed; see create_deferred_indexes().
+ */
+void create_genealogical_comparisons_table(sqlite3 * output_db, bool defer_index, comparison_schema schema) {
+	int rc; //to store SQLite macros
+	if (schema == COMPACT_SCHEMA) {
+		create_compact_genealogical_comparisons_table(output_db, defer_index);
+		return;
+	}
+	if (schema == CLUSTERED_SCHEMA) {
+		create_clustered_genealogical_comparisons_table(output_db);
+		return;
+	}
+	//Create the GENEALOGICAL_COMPARISONS table:
+	string create_genealogical_comparisons_sql = "DROP TABLE IF EXISTS GENEALOGICAL_COMPARISON_PAIRS;"
+			"DROP TABLE IF EXISTS GENEALOGICAL_COMPARISONS_CLUSTERED;"
+			"DROP TABLE IF EXISTS GENEALOGICAL_COMPARISONS;"
+			"CREATE TABLE GENEALOGICAL_COMPARISONS ("
+			"ROW_ID INT NOT NULL, "
+			"PRIMARY_WIT TEXT NOT NULL, "
+			"SECONDARY_WIT TEXT NOT NULL, "
+			"EXTANT_COUNT INTEGER NOT NULL, "
+			"AGREEMENTS_COUNT INTEGER NOT NULL, "
+			"PRIOR_COUNT INTEGER NOT NULL, "
+			"POSTERIOR_COUNT INTEGER NOT NULL, "
+			"NOREL_COUNT INTEGER NOT NULL, "
+			"UNCLEAR_COUNT INTEGER NOT NULL, "
+			"EXPLAINED_COUNT INTEGER NOT NULL, "
+			"EXTANT BLOB NOT NULL, "
+			"AGREEMENTS BLOB NOT NULL, "
+			"PRIOR BLOB NOT NULL, "
+			"POSTERIOR BLOB NOT NULL, "
+			"NOREL BLOB NOT NULL, "
+			"UNCLEAR BLOB NOT NULL, "
+			"EXPLAINED BLOB NOT NULL, "
+			"COST REAL NOT NULL);";
 	char * create_genealogical_comparisons_error_msg;
 	rc = sqlite3_exec(output_db, create_genealogical_comparisons_sql.c_str(), NULL, 0, & create_genealogical_comparisons_error_msg);
 	if (rc != SQLITE_OK) {
-		cerr << "Error creating table GENEALOGICAL_COMPARISONS: " << create_genealogical_comparisons_error_msg << endl;
-		sqlite3_free(create_genealogical_comparisons_error_msg);
+		cerr << "Error creating table GENEALOGICAL_COMPARISONS: " << create_genealogical_comparisons_error_msg << endl;
+		sqlite3_free(create_genealogical_comparisons_error_msg);
+		exit(1);
+	}
+	//Denormalize it (unless indexing has been deferred until after the table is populated):
+	if (!defer_index) {
+		create_table_index(output_db, "GENEALOGICAL_COMPARISONS");
+	}
+	return;
+}
+
+/**
+ * Compresses the bitmaps of the given genealogical comparisons in place before they are serialized.
+ * Run-length encoding the bitmaps' containers where it helps and releasing their excess capacity
+ * makes the serialized BLOBs smaller and reduces the memory held by comparisons waiting to be written.
+ */
+void optimize_genealogical_comparisons(list<genealogical_comparison> & comps) {
+	for (genealogical_comparison & comp : comps) {
+		for (Roaring * bitmap : {& comp.extant, & comp.agreements, & comp.prior, & comp.posterior, & comp.norel, & comp.unclear, & comp.explained}) {
+			bitmap->runOptimize();
+			bitmap->shrinkToFit();
+		}
+	}
+	return;
+}
+
+/**
+ * Adds copies of the given genealogical comparisons for the duplicates of their witnesses, as given by the map from each witness to its duplicates.
+ * A comparison of two witnesses is copied for every pair consisting of the primary witness or one of its duplicates and the secondary witness or one of its duplicates;
+ * in particular, the comparison of a witness with itself is copied for every ordered pair of members of its group,
+ * since two witnesses with identical readings agree (and explain each other) wherever they are extant.
+ */
+void expand_duplicate_comparisons(list<genealogical_comparison> & comps, const unordered_map<string, list<string>> & duplicates) {
+	if (duplicates.empty()) {
+		return;
+	}
+	size_t num_comps = comps.size();
+	list<genealogical_comparison>::iterator it = comps.begin();
+	for (size_t i = 0; i < num_comps; i++, ++it) {
+		list<string> primary_wits = list<string>({it->primary_wit});
+		if (duplicates.find(it->primary_wit) != duplicates.end()) {
+			const list<string> & dups = duplicates.at(it->primary_wit);
+			primary_wits.insert(primary_wits.end(), dups.begin(), dups.end());
+		}
+		list<string> secondary_wits = list<string>({it->secondary_wit});
+		if (duplicates.find(it->secondary_wit) != duplicates.end()) {
+			const list<string> & dups = duplicates.at(it->secondary_wit);
+			secondary_wits.insert(secondary_wits.end(), dups.begin(), dups.end());
+		}
+		for (const string & primary_wit : primary_wits) {
+			for (const string & secondary_wit : secondary_wits) {
+				if (primary_wit == it->primary_wit && secondary_wit == it->secondary_wit) {
+					continue;
+				}
+				genealogical_comparison comp = * it;
+				comp.primary_wit = primary_wit;
+				comp.secondary_wit = secondary_wit;
+				comps.push_back(std::move(comp));
+			}
+		}
+	}
+	return;
+}
+
+/**
+ * Inserts rows for the given genealogical comparisons into the GENEALOGICAL_COMPARISONS table using the given prepared statement.
+ * The comparisons may be supplied in any order;
+ * each row's ID is determined by the positions of its primary and secondary witnesses in the witness list (as given by the map of witness indices)
+ * and is added to the given offset, so that rows sorted by ID are grouped by primary witness and ordered by secondary witness within each group.
+ * The number of variation units in each bitmap is stored alongside it (see create_genealogical_comparisons_table()).
+ * The bitmaps of each row are serialized directly from the comparison into the given scratch buffer,
+ * which is only reallocated when a row needs more space than any row before it,
+ * so that inserting rows does not allocate memory in the steady state.
+ * If the clustered flag is set, then the rows are inserted into the table of the clustered schema, which has no row ID
+ * and identifies the witnesses by their positions in the witness list (see create_clustered_genealogical_comparisons_table()).
+ * Returns the number of bytes of BLOB data inserted.
+ */
+unsigned long long insert_genealogical_comparisons(sqlite3_stmt * insert_into_genealogical_comparisons_stmt, const unordered_map<string, int> & wit_inds, sqlite3_int64 row_id_offset, const list<genealogical_comparison> & comps, vector<char> & scratch, bool clustered) {
+	int rc; //to store SQLite macros
+	unsigned long long blob_bytes = 0;
+	sqlite3_int64 num_wits = (sqlite3_int64) wit_inds.size();
+	for (const genealogical_comparison & comp : comps) {
+		sqlite3_int64 row_id = row_id_offset + wit_inds.at(comp.primary_wit) * num_wits + wit_inds.at(comp.secondary_wit);
+		//Serialize the bitmaps back to back into the scratch buffer, in column order:
+		const Roaring * bitmaps[7] = {& comp.extant, & comp.agreements, & comp.prior, & comp.posterior, & comp.norel, & comp.unclear, & comp.explained};
+		size_t sizes[7];
+		size_t total_size = 0;
+		for (int i = 0; i < 7; i++) {
+			sizes[i] = bitmaps[i]->getSizeInBytes();
+			total_size += sizes[i];
+		}
+		if (scratch.size() < total_size) {
+			scratch.resize(total_size);
+		}
+		blob_bytes += total_size;
+		size_t offset = 0;
+		for (int i = 0; i < 7; i++) {
+			bitmaps[i]->write(scratch.data() + offset);
+			offset += sizes[i];
+		}
+		//Then insert a row containing these values:
+		int col = 1;
+		if (clustered) {
+			sqlite3_bind_int(insert_into_genealogical_comparisons_stmt, col++, wit_inds.at(comp.primary_wit));
+			sqlite3_bind_int(insert_into_genealogical_comparisons_stmt, col++, wit_inds.at(comp.secondary_wit));
+		}
+		else {
+			sqlite3_bind_int64(insert_into_genealogical_comparisons_stmt, col++, row_id);
+			sqlite3_bind_text(insert_into_genealogical_comparisons_stmt, col++, comp.primary_wit.c_str(), -1, SQLITE_STATIC);
+			sqlite3_bind_text(insert_into_genealogical_comparisons_stmt, col++, comp.secondary_wit.c_str(), -1, SQLITE_STATIC);
+		}
+		for (int i = 0; i < 7; i++) {
+			sqlite3_bind_int64(insert_into_genealogical_comparisons_stmt, col++, (sqlite3_int64) bitmaps[i]->cardinality());
+		}
+		offset = 0;
+		for (int i = 0; i < 7; i++) {
+			sqlite3_bind_blob(insert_into_genealogical_comparisons_stmt, col++, scratch.data() + offset, (int) sizes[i], SQLITE_STATIC);
+			offset += sizes[i];
+		}
+		sqlite3_bind_double(insert_into_genealogical_comparisons_stmt, col, comp.cost);
+		rc = sqlite3_step(insert_into_genealogical_comparisons_stmt);
+		if (rc != SQLITE_DONE) {
+			cerr << "Error executing prepared statement." << endl;
+			exit(1);
+		}
+		//Then reset the prepared statement so we can bind the next values to it:
+		sqlite3_reset(insert_into_genealogical_comparisons_stmt);
+	}
+	return blob_bytes;
+}
+
+/**
+ * Inserts rows for the given genealogical comparisons into the GENEALOGICAL_COMPARISON_PAIRS table of the compact schema using the given prepared statement.
+ * Only the comparisons whose primary witness comes no later in the witness list than their secondary witness are inserted,
+ * each together with the EXPLAINED bitmap and cost of its mirrored comparison, which must also be among the given comparisons.
+ * Row IDs, serialization, and the return value are as in insert_genealogical_comparisons().
+ */
+unsigned long long insert_compact_genealogical_comparisons(sqlite3_stmt * insert_into_genealogical_comparison_pairs_stmt, const unordered_map<string, int> & wit_inds, sqlite3_int64 row_id_offset, const list<genealogical_comparison> & comps, vector<char> & scratch) {
+	int rc; //to store SQLite macros
+	unsigned long long blob_bytes = 0;
+	sqlite3_int64 num_wits = (sqlite3_int64) wit_inds.size();
+	//Index the mirrored comparisons by their row IDs:
+	unordered_map<sqlite3_int64, const genealogical_comparison *> mirrored_comps = unordered_map<sqlite3_int64, const genealogical_comparison *>();
+	for (const genealogical_comparison & comp : comps) {
+		sqlite3_int64 primary_wit_ind = wit_inds.at(comp.primary_wit);
+		sqlite3_int64 secondary_wit_ind = wit_inds.at(comp.secondary_wit);
+		if (primary_wit_ind >= secondary_wit_ind) {
+			mirrored_comps[primary_wit_ind * num_wits + secondary_wit_ind] = & comp;
+		}
+	}
+	for (const genealogical_comparison & comp : comps) {
+		sqlite3_int64 primary_wit_ind = wit_inds.at(comp.primary_wit);
+		sqlite3_int64 secondary_wit_ind = wit_inds.at(comp.secondary_wit);
+		if (primary_wit_ind > secondary_wit_ind) {
+			continue;
+		}
+		const genealogical_comparison & mirrored_comp = * mirrored_comps.at(secondary_wit_ind * num_wits + primary_wit_ind);
+		sqlite3_int64 row_id = row_id_offset + primary_wit_ind * num_wits + secondary_wit_ind;
+		//Serialize the bitmaps back to back into the scratch buffer, in column order:
+		const Roaring * bitmaps[7] = {& comp.extant, & comp.agreements, & comp.prior, & comp.posterior, & comp.unclear, & comp.explained, & mirrored_comp.explained};
+		size_t sizes[7];
+		size_t total_size = 0;
+		for (int i = 0; i < 7; i++) {
+			sizes[i] = bitmaps[i]->getSizeInBytes();
+			total_size += sizes[i];
+		}
+		if (scratch.size() < total_size) {
+			scratch.resize(total_size);
+		}
+		blob_bytes += total_size;
+		size_t offset = 0;
+		for (int i = 0; i < 7; i++) {
+			bitmaps[i]->write(scratch.data() + offset);
+			offset += sizes[i];
+		}
+		//Then insert a row containing these values:
+		sqlite3_bind_int64(insert_into_genealogical_comparison_pairs_stmt, 1, row_id);
+		sqlite3_bind_text(insert_into_genealogical_comparison_pairs_stmt, 2, comp.primary_wit.c_str(), -1, SQLITE_STATIC);
+		sqlite3_bind_text(insert_into_genealogical_comparison_pairs_stmt, 3, comp.secondary_wit.c_str(), -1, SQLITE_STATIC);
+		const Roaring * counted_bitmaps[8] = {& comp.extant, & comp.agreements, & comp.prior, & comp.posterior, & comp.norel, & comp.unclear, & comp.explained, & mirrored_comp.explained};
+		for (int i = 0; i < 8; i++) {
+			sqlite3_bind_int64(insert_into_genealogical_comparison_pairs_stmt, 4 + i, (sqlite3_int64) counted_bitmaps[i]->cardinality());
+		}
+		offset = 0;
+		for (int i = 0; i < 7; i++) {
+			sqlite3_bind_blob(insert_into_genealogical_comparison_pairs_stmt, 12 + i, scratch.data() + offset, (int) sizes[i], SQLITE_STATIC);
+			offset += sizes[i];
+		}
+		sqlite3_bind_double(insert_into_genealogical_comparison_pairs_stmt, 19, comp.cost);
+		sqlite3_bind_double(insert_into_genealogical_comparison_pairs_stmt, 20, mirrored_comp.cost);
+		rc = sqlite3_step(insert_into_genealogical_comparison_pairs_stmt);
+		if (rc != SQLITE_DONE) {
+			cerr << "Error executing prepared statement." << endl;
+			exit(1);
+		}
+		//Then reset the prepared statement so we can bind the next values to it:
+		sqlite3_reset(insert_into_genealogical_comparison_pairs_stmt);
+	}
+	return blob_bytes;
+}
+
+/**
+ * A unit of work for the comparison workers:
+ * the comparisons of one primary witness with the witnesses in a half-open range of witness indices, in both directions.
+ */
+struct comparison_task {
+	unsigned int primary_wit_ind;
+	unsigned int begin_wit_ind;
+	unsigned int end_wit_ind;
+	unsigned long long cost; //estimated cost of the task
+};
+
+/**
+ * The comparisons calculated for a comparison task, as handed from a worker thread to the writer thread.
+ * If the comparisons were spilled to disk to stay within the memory budget, then the batch only records where they were written.
+ */
+struct comparison_batch {
+	comparison_task task;
+	list<genealogical_comparison> comps;
+	bool spilled;
+	long long spill_offset; //position of the serialized comparisons in the spill file
+	size_t spill_size; //number of bytes of serialized comparisons in the spill file
+};
+
+/**
+ * Returns an upper bound on the number of bytes of memory that the comparisons for the given task will occupy,
+ * once they have been copied for the duplicates of their witnesses (as given by the size of each witness's group of witnesses with identical readings).
+ * Each comparison's extant bitmap, the agreements, prior, posterior, norel, and unclear bitmaps that partition it, and its explained bitmap
+ * hold at most three times as many values as there are units at which the primary witness is extant,
+ * and a Roaring bitmap never needs more than two bytes per value (plus a small fixed overhead).
+ */
+size_t estimate_batch_memory(const comparison_engine & engine, const comparison_task & task, const vector<unsigned long long> & group_sizes) {
+	unsigned long long extant = engine.get_extant_counts()[task.primary_wit_ind];
+	unsigned long long bytes_per_comp = 6 * extant + 1024;
+	unsigned long long num_pairs = 0;
+	for (unsigned int wit_ind = task.begin_wit_ind; wit_ind < task.end_wit_ind; wit_ind++) {
+		num_pairs += group_sizes[task.primary_wit_ind] * group_sizes[wit_ind];
+	}
+	return (size_t) (2 * num_pairs * bytes_per_comp);
+}
+
+/**
+ * Returns the number of bytes of memory occupied by the given comparisons, as used for memory budgeting.
+ */
+size_t get_batch_memory(const list<genealogical_comparison> & comps) {
+	size_t bytes = 0;
+	for (const genealogical_comparison & comp : comps) {
+		bytes += sizeof(genealogical_comparison) + comp.primary_wit.size() + comp.secondary_wit.size();
+		for (const Roaring * bitmap : {& comp.extant, & comp.agreements, & comp.prior, & comp.posterior, & comp.norel, & comp.unclear, & comp.explained}) {
+			bytes += bitmap->getSizeInBytes();
+		}
+	}
+	return bytes;
+}
+
+/**
+ * Temporary file to which worker threads spill batches of comparisons that do not fit in the memory budget,
+ * and from which the writer thread reads them back when it reaches them in the queue.
+ * Each batch is serialized as a sequence of comparisons, each consisting of its primary and secondary witness indices and its cost,
+ * followed by the size and contents of each of its seven bitmaps in column order.
+ * The file is created when the first batch is spilled and deleted when this object is destroyed.
+ */
+class spill_file {
+private:
+	string filename;
+	FILE * file;
+	long long end_offset;
+	unsigned long long num_batches;
+	mutex mtx;
+	/**
+	 * Moves the file position to the given offset from the start of the file.
+	 */
+	void seek(long long offset) {
+		#ifdef _WIN32
+			_fseeki64(file, offset, SEEK_SET);
+		#else
+			fseeko(file, (off_t) offset, SEEK_SET);
+		#endif
+	}
+public:
+	spill_file(const string & _filename) {
+		filename = _filename;
+		file = NULL;
+		end_offset = 0;
+		num_batches = 0;
+	}
+	~spill_file() {
+		if (file != NULL) {
+			fclose(file);
+			remove(filename.c_str());
+		}
+	}
+	/**
+	 * Serializes the given comparisons, using the given map of witness indices and scratch buffer,
+	 * and appends them to the file, recording their location in the given batch.
+	 */
+	void write(comparison_batch & batch, const unordered_map<string, int> & wit_inds, vector<char> & scratch) {
+		size_t size = 0;
+		for (const genealogical_comparison & comp : batch.comps) {
+			size += 2 * sizeof(uint32_t) + sizeof(float);
+			for (const Roaring * bitmap : {& comp.extant, & comp.agreements, & comp.prior, & comp.posterior, & comp.norel, & comp.unclear, & comp.explained}) {
+				size += sizeof(uint32_t) + bitmap->getSizeInBytes();
+			}
+		}
+		if (scratch.size() < size) {
+			scratch.resize(size);
+		}
+		char * pos = scratch.data();
+		for (const genealogical_comparison & comp : batch.comps) {
+			uint32_t primary_wit_ind = (uint32_t) wit_inds.at(comp.primary_wit);
+			uint32_t secondary_wit_ind = (uint32_t) wit_inds.at(comp.secondary_wit);
+			memcpy(pos, & primary_wit_ind, sizeof(uint32_t));
+			pos += sizeof(uint32_t);
+			memcpy(pos, & secondary_wit_ind, sizeof(uint32_t));
+			pos += sizeof(uint32_t);
+			memcpy(pos, & comp.cost, sizeof(float));
+			pos += sizeof(float);
+			for (const Roaring * bitmap : {& comp.extant, & comp.agreements, & comp.prior, & comp.posterior, & comp.norel, & comp.unclear, & comp.explained}) {
+				uint32_t bitmap_size = (uint32_t) bitmap->getSizeInBytes();
+				memcpy(pos, & bitmap_size, sizeof(uint32_t));
+				pos += sizeof(uint32_t);
+				bitmap->write(pos);
+				pos += bitmap_size;
+			}
+		}
+		lock_guard<mutex> lock(mtx);
+		if (file == NULL) {
+			file = fopen(filename.c_str(), "w+b");
+			if (file == NULL) {
+				cerr << "Error opening spill file " << filename << "." << endl;
+				exit(1);
+			}
+		}
+		seek(end_offset);
+		if (fwrite(scratch.data(), 1, size, file) != size) {
+			cerr << "Error writing to spill file " << filename << "." << endl;
+			exit(1);
+		}
+		batch.spilled = true;
+		batch.spill_offset = end_offset;
+		batch.spill_size = size;
+		batch.comps.clear();
+		end_offset += (long long) size;
+		num_batches++;
+		return;
+	}
+	/**
+	 * Reads the comparisons of the given spilled batch back into it, using the given witness list and scratch buffer.
+	 */
+	void read(comparison_batch & batch, const vector<string> & list_wit, vector<char> & scratch) {
+		if (scratch.size() < batch.spill_size) {
+			scratch.resize(batch.spill_size);
+		}
+		{
+			lock_guard<mutex> lock(mtx);
+			seek(batch.spill_offset);
+			if (fread(scratch.data(), 1, batch.spill_size, file) != batch.spill_size) {
+				cerr << "Error reading from spill file " << filename << "." << endl;
+				exit(1);
+			}
+		}
+		const char * pos = scratch.data();
+		const char * end = pos + batch.spill_size;
+		while (pos < end) {
+			genealogical_comparison comp;
+			uint32_t primary_wit_ind;
+			uint32_t secondary_wit_ind;
+			memcpy(& primary_wit_ind, pos, sizeof(uint32_t));
+			pos += sizeof(uint32_t);
+			memcpy(& secondary_wit_ind, pos, sizeof(uint32_t));
+			pos += sizeof(uint32_t);
+			memcpy(& comp.cost, pos, sizeof(float));
+			pos += sizeof(float);
+			comp.primary_wit = list_wit[primary_wit_ind];
+			comp.secondary_wit = list_wit[secondary_wit_ind];
+			for (Roaring * bitmap : {& comp.extant, & comp.agreements, & comp.prior, & comp.posterior, & comp.norel, & comp.unclear, & comp.explained}) {
+				uint32_t bitmap_size;
+				memcpy(& bitmap_size, pos, sizeof(uint32_t));
+				pos += sizeof(uint32_t);
+				* bitmap = Roaring::readSafe(pos, bitmap_size);
+				pos += bitmap_size;
+			}
+			batch.comps.push_back(std::move(comp));
+		}
+		batch.spilled = false;
+		return;
+	}
+	/**
+	 * Returns the number of batches spilled to the file so far.
+	 */
+	unsigned long long get_num_batches() {
+		lock_guard<mutex> lock(mtx);
+		return num_batches;
+	}
+	/**
+	 * Returns the number of bytes spilled to the file so far.
+	 */
+	long long get_size() {
+		lock_guard<mutex> lock(mtx);
+		return end_offset;
+	}
+};
+
+/**
+ * A deterministic subset of the primary witnesses, for populating the genealogical cache in several independent runs:
+ * shard index i (counting from 0) of a given number of shards.
+ */
+struct shard_spec {
+	unsigned int index;
+	unsigned int count;
+};
+
+/**
+ * Returns true if the primary witness at the given index in a list of the given number of witnesses belongs to the given shard.
+ * Since the primary witness at index i is compared to the num_wits - i witnesses from itself onward,
+ * the witnesses at indices i and num_wits - 1 - i are always assigned to the same shard,
+ * so that every shard has roughly the same number of comparisons to calculate.
+ */
+bool in_shard(unsigned int wit_ind, unsigned int num_wits, const shard_spec & shard) {
+	unsigned int pair_ind = std::min(wit_ind, num_wits - 1 - wit_ind);
+	return pair_ind % shard.count == shard.index;
+}
+
+/**
+ * Returns the comparison tasks for the given engine, ordered from largest to smallest estimated cost.
+ * The task for a primary witness covers itself and every witness after it;
+ * if a first secondary witness index is given, then only pairs whose later witness is at or after that index are covered
+ * (so that comparisons for witnesses appended to an existing cache can be calculated without recalculating the rest).
+ * Ranges of witnesses already covered by the given completed tasks (e.g., from an interrupted run) are skipped,
+ * as are primary witnesses that do not belong to the given shard.
+ * The cost of a task is estimated as the number of units at which its primary witness is extant times the number of witnesses it covers.
+ * Tasks that would take more than a fraction of one thread's share of the total work are split into smaller ranges of secondary witnesses,
+ * and handing out the remaining tasks largest-first keeps any one thread from being left with a large task at the end.
+ */
+vector<comparison_task> get_comparison_tasks(const comparison_engine & engine, unsigned int num_threads, unsigned int first_secondary_wit_ind = 0, const vector<comparison_task> & completed_tasks = vector<comparison_task>(), const shard_spec & shard = {0, 1}) {
+	vector<string> list_wit = engine.get_list_wit();
+	vector<unsigned int> extant_counts = engine.get_extant_counts();
+	unsigned int num_wits = (unsigned int) list_wit.size();
+	//Group the completed ranges by primary witness:
+	vector<vector<pair<unsigned int, unsigned int>>> completed_ranges = vector<vector<pair<unsigned int, unsigned int>>>(num_wits);
+	for (const comparison_task & task : completed_tasks) {
+		if (task.primary_wit_ind < num_wits) {
+			completed_ranges[task.primary_wit_ind].push_back(pair<unsigned int, unsigned int>(task.begin_wit_ind, task.end_wit_ind));
+		}
+	}
+	//Then find the remaining ranges of secondary witnesses for each primary witness:
+	vector<vector<pair<unsigned int, unsigned int>>> remaining_ranges = vector<vector<pair<unsigned int, unsigned int>>>(num_wits);
+	unsigned long long total_cost = 0;
+	for (unsigned int wit_ind = 0; wit_ind < num_wits; wit_ind++) {
+		if (!in_shard(wit_ind, num_wits, shard)) {
+			continue;
+		}
+		vector<pair<unsigned int, unsigned int>> & completed = completed_ranges[wit_ind];
+		sort(completed.begin(), completed.end());
+		unsigned int begin_wit_ind = std::max(wit_ind, first_secondary_wit_ind);
+		for (const pair<unsigned int, unsigned int> & range : completed) {
+			if (range.first > begin_wit_ind) {
+				remaining_ranges[wit_ind].push_back(pair<unsigned int, unsigned int>(begin_wit_ind, std::min(range.first, num_wits)));
+			}
+			begin_wit_ind = std::max(begin_wit_ind, range.second);
+		}
+		if (begin_wit_ind < num_wits) {
+			remaining_ranges[wit_ind].push_back(pair<unsigned int, unsigned int>(begin_wit_ind, num_wits));
+		}
+		for (const pair<unsigned int, unsigned int> & range : remaining_ranges[wit_ind]) {
+			total_cost += ((unsigned long long) extant_counts[wit_ind] + 1) * (range.second - range.first);
+		}
+	}
+	//Allow each thread roughly eight tasks' worth of work:
+	unsigned long long max_task_cost = std::max(1ULL, total_cost / (8ULL * num_threads));
+	vector<comparison_task> tasks = vector<comparison_task>();
+	for (unsigned int wit_ind = 0; wit_ind < num_wits; wit_ind++) {
+		unsigned long long cost_per_wit = (unsigned long long) extant_counts[wit_ind] + 1;
+		unsigned int wits_per_task = (unsigned int) std::max(1ULL, std::min((unsigned long long) num_wits, max_task_cost / cost_per_wit));
+		for (const pair<unsigned int, unsigned int> & range : remaining_ranges[wit_ind]) {
+			for (unsigned int begin_wit_ind = range.first; begin_wit_ind < range.second; begin_wit_ind += wits_per_task) {
+				comparison_task task;
+				task.primary_wit_ind = wit_ind;
+				task.begin_wit_ind = begin_wit_ind;
+				task.end_wit_ind = std::min(range.second, begin_wit_ind + wits_per_task);
+				task.cost = cost_per_wit * (task.end_wit_ind - task.begin_wit_ind);
+				tasks.push_back(task);
+			}
+		}
+	}
+	stable_sort(tasks.begin(), tasks.end(), [](const comparison_task & t1, const comparison_task & t2) {
+		return t1.cost > t2.cost;
+	});
+	return tasks;
+}
+
+#ifdef POPULATE_DB_TESTING
+/**
+ * Checkpoint after which the run is to be interrupted, as set by the --interrupt-after option, which is used to test resuming interrupted runs:
+ * either the name of a table, which is reached once that table has been populated, or a number of comparison tasks, which is reached once that many have been committed.
+ * If this is empty, then the run is not interrupted.
+ * The option is only compiled into builds with tests enabled (see scripts/CMakeLists.txt).
+ */
+string interrupt_checkpoint = string();
+
+/**
+ * If the given checkpoint is the one after which the run is to be interrupted,
+ * then exits immediately, without closing the database or finishing any other work, as if the process had been killed.
+ */
+void check_interrupt(const string & checkpoint) {
+	if (!interrupt_checkpoint.empty() && checkpoint == interrupt_checkpoint) {
+		cout << "Interrupting run after " << checkpoint << "." << endl;
+		_Exit(2);
+	}
+	return;
+}
+#else
+/**
+ * Does nothing; runs can only be interrupted at checkpoints in builds with tests enabled.
+ */
+inline void check_interrupt(const string & checkpoint) {
+	return;
+}
+#endif
+
+/**
+ * Drops the METADATA and COMPARISON_PROGRESS tables from the given database in a single transaction, if they exist.
+ * This must be done before a run that does not resume an interrupted one changes any other table,
+ * so that if the run is itself interrupted, a later run with the --resume option will not mistake the previous run's tables for a record of this one.
+ */
+void discard_interrupted_run(sqlite3 * output_db) {
+	int rc; //to store SQLite macros
+	char * drop_error_msg;
+	rc = sqlite3_exec(output_db, "BEGIN TRANSACTION; DROP TABLE IF EXISTS METADATA; DROP TABLE IF EXISTS COMPARISON_PROGRESS; END TRANSACTION;", NULL, 0, & drop_error_msg);
+	if (rc != SQLITE_OK) {
+		cerr << "Error dropping tables METADATA and COMPARISON_PROGRESS: " << drop_error_msg << endl;
+		sqlite3_free(drop_error_msg);
+		exit(1);
+	}
+	return;
+}
+
+/**
+ * Creates the COMPARISON_PROGRESS table, which records the comparison tasks whose rows have been committed to the GENEALOGICAL_COMPARISONS table,
+ * so that an interrupted run can be resumed.
+ * This table is small and is only read in full, so it is not indexed.
+ */
+void create_comparison_progress_table(sqlite3 * output_db) {
+	int rc; //to store SQLite macros
+	string create_comparison_progress_sql = "DROP TABLE IF EXISTS COMPARISON_PROGRESS;"
+			"CREATE TABLE COMPARISON_PROGRESS ("
+			"PRIMARY_WIT_IND INT NOT NULL, "
+			"BEGIN_WIT_IND INT NOT NULL, "
+			"END_WIT_IND INT NOT NULL);";
+	char * create_comparison_progress_error_msg;
+	rc = sqlite3_exec(output_db, create_comparison_progress_sql.c_str(), NULL, 0, & create_comparison_progress_error_msg);
+	if (rc != SQLITE_OK) {
+		cerr << "Error creating table COMPARISON_PROGRESS: " << create_comparison_progress_error_msg << endl;
+		sqlite3_free(create_comparison_progress_error_msg);
+		exit(1);
+	}
+	return;
+}
+
+/**
+ * Drops the COMPARISON_PROGRESS table from the given database, if it exists.
+ * This is done whenever a cache is changed in place, since the recorded tasks would no longer describe its rows,
+ * and a later run with the --resume option would otherwise calculate comparisons from stale progress.
+ */
+void drop_comparison_progress_table(sqlite3 * output_db) {
+	int rc; //to store SQLite macros
+	char * drop_comparison_progress_error_msg;
+	rc = sqlite3_exec(output_db, "DROP TABLE IF EXISTS COMPARISON_PROGRESS;", NULL, 0, & drop_comparison_progress_error_msg);
+	if (rc != SQLITE_OK) {
+		cerr << "Error dropping table COMPARISON_PROGRESS: " << drop_comparison_progress_error_msg << endl;
+		sqlite3_free(drop_comparison_progress_error_msg);
+		exit(1);
+	}
+	return;
+}
+
+/**
+ * Returns the comparison tasks recorded as completed in the COMPARISON_PROGRESS table of the given database.
+ */
+vector<comparison_task> read_completed_tasks(sqlite3 * output_db) {
+	int rc; //to store SQLite macros
+	vector<comparison_task> completed_tasks = vector<comparison_task>();
+	sqlite3_stmt * select_from_comparison_progress_stmt;
+	sqlite3_prepare(output_db, "SELECT PRIMARY_WIT_IND, BEGIN_WIT_IND, END_WIT_IND FROM COMPARISON_PROGRESS", -1, & select_from_comparison_progress_stmt, 0);
+	rc = sqlite3_step(select_from_comparison_progress_stmt);
+	while (rc == SQLITE_ROW) {
+		comparison_task task;
+		task.primary_wit_ind = (unsigned int) sqlite3_column_int(select_from_comparison_progress_stmt, 0);
+		task.begin_wit_ind = (unsigned int) sqlite3_column_int(select_from_comparison_progress_stmt, 1);
+		task.end_wit_ind = (unsigned int) sqlite3_column_int(select_from_comparison_progress_stmt, 2);
+		task.cost = 0;
+		completed_tasks.push_back(task);
+		rc = sqlite3_step(select_from_comparison_progress_stmt);
+	}
+	sqlite3_finalize(select_from_comparison_progress_stmt);
+	return completed_tasks;
+}
+
+/**
+ * Calculates the genealogical comparisons for the given tasks and inserts them into the GENEALOGICAL_COMPARISONS table, with row IDs starting at the given offset.
+ * The given number of worker threads claim the tasks in order by advancing a shared atomic counter,
+ * so no lock is taken to distribute work, and each thread that finishes a task immediately claims the next one.
+ * The workers hand their comparisons to a dedicated writer thread through a queue holding at most the given number of batches.
+ * The writer commits each batch under its own savepoint (which acts as a transaction unless the caller has already begun one) and frees it immediately afterward,
+ * so peak memory is bounded by the queue depth rather than by the number of pairs of witnesses.
+ * If the record_progress flag is set, then each batch's task is recorded in the COMPARISON_PROGRESS table under the same savepoint,
+ * so that the table always describes exactly the rows that have been committed.
+ * The engine may compare only one witness of each group of witnesses with identical readings;
+ * in that case, each worker copies its comparisons for the other members of each group (as given by the map of duplicates) before queuing them,
+ * so that the copies count against the memory budget, and the row IDs are determined by the positions of the witnesses in the given witness list of the cache.
+ * If a memory budget (in bytes) is given, then half of it is reserved for the batches being calculated,
+ * and the number of worker threads is reduced if the largest batches would not otherwise fit in that half;
+ * the other half is reserved for the batches waiting to be written, and any batch that would not fit in it is spilled to a temporary file next to the database,
+ * from which the writer reads it back when it reaches it in the queue. In this case, the queue depth does not limit the number of waiting batches.
+ * The comparisons are inserted into the table of the given schema; for the compact schema,
+ * this relies on each task's batch containing the comparisons of its pairs of witnesses in both directions (see insert_compact_genealogical_comparisons()).
+ * Returns the number of bytes of BLOB data inserted.
+ */
+unsigned long long calculate_genealogical_comparisons(sqlite3 * output_db, const comparison_engine & engine, const list<string> & cache_list_wit, const unordered_map<string, list<string>> & duplicates, const vector<comparison_task> & tasks, sqlite3_int64 row_id_offset, unsigned int num_threads, unsigned int queue_depth, bool record_progress, unsigned long long max_memory, comparison_schema schema) {
+	vector<string> list_wit = engine.get_list_wit();
+	//Map each witness ID to its position in the cache's witness list, which determines the row IDs
+	//(spilled batches also refer to their witnesses by these positions, since their comparisons already include those of duplicate witnesses):
+	vector<string> row_list_wit = vector<string>(cache_list_wit.begin(), cache_list_wit.end());
+	unordered_map<string, int> row_wit_inds = unordered_map<string, int>();
+	for (string wit_id : row_list_wit) {
+		int wit_ind = (int) row_wit_inds.size();
+		row_wit_inds[wit_id] = wit_ind;
+	}
+	//If there is a memory budget, then use only as many workers as can hold their largest batches within half of it:
+	unsigned int num_workers = num_threads;
+	size_t max_queue_weight = 0;
+	if (max_memory > 0) {
+		//Count each witness in the engine's witness list together with its duplicates:
+		vector<unsigned long long> group_sizes = vector<unsigned long long>(list_wit.size(), 1);
+		for (unsigned int wit_ind = 0; wit_ind < list_wit.size(); wit_ind++) {
+			if (duplicates.find(list_wit[wit_ind]) != duplicates.end()) {
+				group_sizes[wit_ind] += duplicates.at(list_wit[wit_ind]).size();
+			}
+		}
+		size_t max_batch_memory = 1;
+		for (const comparison_task & task : tasks) {
+			max_batch_memory = std::max(max_batch_memory, estimate_batch_memory(engine, task, group_sizes));
+		}
+		num_workers = (unsigned int) std::max(1ULL, std::min((unsigned long long) num_threads, (max_memory / 2) / max_batch_memory));
+		if (num_workers < num_threads) {
+			cout << "Using " << num_workers << " of " << num_threads << " threads to stay within the memory budget..." << endl;
+		}
+		max_queue_weight = (size_t) std::max(1ULL, max_memory / 2);
+		//The batches held in memory are bounded by this weight rather than by the queue depth,
+		//and a spilled batch waits in the queue as an empty placeholder that holds no comparisons,
+		//so the depth is raised to the number of tasks, letting workers keep calculating (and spilling) instead of blocking while the writer catches up:
+		queue_depth = std::max(queue_depth, (unsigned int) tasks.size());
+	}
+	const char * db_filename = sqlite3_db_filename(output_db, "main");
+	spill_file spill((db_filename != NULL && db_filename[0] != '\0' ? string(db_filename) : string("populate_db")) + "-spill");
+	unsigned long long blob_bytes = 0;
+	bounded_queue<comparison_batch> queue(queue_depth, num_workers, max_queue_weight);
+	//Start the writer thread:
+	thread writer = thread([&]() {
+		unsigned long long num_committed = 0;
+		int rc; //to store SQLite macros
+		sqlite3_stmt * insert_into_genealogical_comparisons_stmt;
+		if (schema == COMPACT_SCHEMA) {
+			rc = sqlite3_prepare(output_db, "INSERT INTO GENEALOGICAL_COMPARISON_PAIRS VALUES (?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?)", -1, & insert_into_genealogical_comparisons_stmt, 0);
+		}
+		else if (schema == CLUSTERED_SCHEMA) {
+			rc = sqlite3_prepare(output_db, "INSERT INTO GENEALOGICAL_COMPARISONS_CLUSTERED VALUES (?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?)", -1, & insert_into_genealogical_comparisons_stmt, 0);
+		}
+		else {
+			rc = sqlite3_prepare(output_db, "INSERT INTO GENEALOGICAL_COMPARISONS VALUES (?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?)", -1, & insert_into_genealogical_comparisons_stmt, 0);
+		}
+		if (rc != SQLITE_OK) {
+			cerr << "Error preparing statement." << endl;
+			exit(1);
+		}
+		sqlite3_stmt * insert_into_comparison_progress_stmt = NULL;
+		if (record_progress) {
+			rc = sqlite3_prepare(output_db, "INSERT INTO COMPARISON_PROGRESS VALUES (?,?,?)", -1, & insert_into_comparison_progress_stmt, 0);
+			if (rc != SQLITE_OK) {
+				cerr << "Error preparing statement." << endl;
+				exit(1);
+			}
+		}
+		vector<char> scratch = vector<char>();
+		comparison_batch batch;
+		while (queue.pop(batch)) {
+			if (batch.spilled) {
+				spill.read(batch, row_list_wit, scratch);
+			}
+			execute_sql(output_db, "SAVEPOINT GENEALOGICAL_COMPARISONS_BATCH");
+			if (schema == COMPACT_SCHEMA) {
+				blob_bytes += insert_compact_genealogical_comparisons(insert_into_genealogical_comparisons_stmt, row_wit_inds, row_id_offset, batch.comps, scratch);
+			}
+			else {
+				blob_bytes += insert_genealogical_comparisons(insert_into_genealogical_comparisons_stmt, row_wit_inds, row_id_offset, batch.comps, scratch, schema == CLUSTERED_SCHEMA);
+			}
+			if (record_progress) {
+				sqlite3_bind_int(insert_into_comparison_progress_stmt, 1, batch.task.primary_wit_ind);
+				sqlite3_bind_int(insert_into_comparison_progress_stmt, 2, batch.task.begin_wit_ind);
+				sqlite3_bind_int(insert_into_comparison_progress_stmt, 3, batch.task.end_wit_ind);
+				rc = sqlite3_step(insert_into_comparison_progress_stmt);
+				if (rc != SQLITE_DONE) {
+					cerr << "Error executing prepared statement." << endl;
+					exit(1);
+				}
+				sqlite3_reset(insert_into_comparison_progress_stmt);
+			}
+			//If the batch cannot be committed, then the run must stop before it counts the batch's task as done:
+			execute_sql(output_db, "RELEASE GENEALOGICAL_COMPARISONS_BATCH");
+			batch.comps.clear();
+			num_committed++;
+			check_interrupt(to_string(num_committed));
+		}
+		sqlite3_finalize(insert_into_genealogical_comparisons_stmt);
+		if (record_progress) {
+			sqlite3_finalize(insert_into_comparison_progress_stmt);
+		}
+	});
+	//Then start the worker threads:
+	vector<thread> workers;
+	atomic<size_t> next_task_ind(0);
+	for (unsigned int i = 0; i < num_workers; ++i) {
+		workers.push_back(thread([&]() {
+			vector<char> scratch = vector<char>();
+			for (;;) {
+				size_t task_ind = next_task_ind.fetch_add(1);
+				if (task_ind >= tasks.size()) {
+					break;
+				}
+				const comparison_task & task = tasks[task_ind];
+				//Only report a witness once, when the task that includes its self-comparison is claimed:
+				if (task.begin_wit_ind == task.primary_wit_ind) {
+					stringstream msg;
+					msg << "Calculating coherence for witness " << list_wit[task.primary_wit_ind] << "..." << endl;
+					cout << msg.str();
+				}
+				comparison_batch batch;
+				batch.task = task;
+				batch.comps = engine.compare_from(task.primary_wit_ind, task.begin_wit_ind, task.end_wit_ind);
+				batch.spilled = false;
+				optimize_genealogical_comparisons(batch.comps);
+				expand_duplicate_comparisons(batch.comps, duplicates);
+				if (max_memory == 0) {
+					queue.push(std::move(batch));
+				}
+				//If the batch does not fit in the memory budget, then spill it to disk and queue a placeholder:
+				else if (!queue.try_push(std::move(batch), get_batch_memory(batch.comps))) {
+					spill.write(batch, row_wit_inds, scratch);
+					queue.push(std::move(batch));
+				}
+			}
+			queue.producer_done();
+		}));
+	}
+	for (thread & t : workers) {
+		t.join();
+	}
+	writer.join();
+	if (spill.get_num_batches() > 0) {
+		cout << "Spilled " << spill.get_num_batches() << " batches (" << (spill.get_size() / (1024 * 1024)) << " MB) to disk to stay within the memory budget." << endl;
+	}
+	return blob_bytes;
+}
+
+/**
+ * Creates, indexes, and populates the GENEALOGICAL_COMPARISONS table with the comparisons between all pairs of witnesses while they are being calculated.
+ * If the defer_index flag is set, then the table is not indexed; see create_deferred_indexes().
+ * If the resume flag is set, then the existing table is kept, and only the comparisons not recorded in the COMPARISON_PROGRESS table are calculated.
+ * Only the comparisons whose primary witnesses belong to the given shard are calculated (along with their mirrored comparisons).
+ * If a memory budget (in bytes) is given, then the comparisons are calculated within it,
+ * and if the engine compares only one witness of each group of witnesses with identical readings, then the comparisons are copied for their duplicates;
+ * see calculate_genealogical_comparisons().
+ * The comparisons are stored in the given schema; see comparison_schema.
+ * Returns the number of bytes of BLOB data inserted.
+ */
+unsigned long long populate_genealogical_comparisons_table(sqlite3 * output_db, const comparison_engine & engine, const list<string> & list_wit, const unordered_map<string, list<string>> & duplicates, unsigned int num_threads, unsigned int queue_depth, bool defer_index, bool resume, const shard_spec & shard, unsigned long long max_memory, comparison_schema schema) {
+	vector<comparison_task> completed_tasks = vector<comparison_task>();
+	if (resume) {
+		completed_tasks = read_completed_tasks(output_db);
+	}
+	else {
+		create_genealogical_comparisons_table(output_db, defer_index, schema);
+		create_comparison_progress_table(output_db);
+	}
+	vector<comparison_task> tasks = get_comparison_tasks(engine, num_threads, 0, completed_tasks, shard);
+	if (resume) {
+		cout << "Resuming with " << tasks.size() << " remaining tasks (" << completed_tasks.size() << " already completed)..." << endl;
+	}
+	return calculate_genealogical_comparisons(output_db, engine, list_wit, duplicates, tasks, 0, num_threads, queue_depth, true, max_memory, schema);
+}
+
+/**
+ * Creates, indexes, and populates the WITNESSES table.
+ * If the defer_index flag is set, then the table is not indexed; see create_deferred_indexes().
+ * Each witness's row records the number of variation units at which it is extant, as given by the map of extant counts.
+ */
+void populate_witnesses_table(sqlite3 * output_db, const list<string> & list_wit, const unordered_map<string, int> & extant_counts, bool defer_index) {
+	int rc; //to store SQLite macros
+	//Create the WITNESSES table:
+	string create_witnesses_sql = "DROP TABLE IF EXISTS WITNESSES;"
+			"CREATE TABLE WITNESSES ("
+			"ROW_ID INT NOT NULL, "
+			"WITNESS TEXT NOT NULL, "
+			"EXTANT_PASSAGES INT NOT NULL);";
+	char * create_witnesses_error_msg;
+	rc = sqlite3_exec(output_db, create_witnesses_sql.c_str(), NULL, 0, & create_witnesses_error_msg);
+	if (rc != SQLITE_OK) {
+		cerr << "Error creating table WITNESSES: " << create_witnesses_error_msg << endl;
+		sqlite3_free(create_witnesses_error_msg);
+		exit(1);
+	}
+	//Denormalize it (unless indexing has been deferred until after the table is populated):
+	if (!defer_index) {
+		create_table_index(output_db, "WITNESSES");
+	}
+	//Then populate it using prepared statements within a single transaction:
+	char * transaction_error_msg;
+	sqlite3_exec(output_db, "BEGIN TRANSACTION", NULL, NULL, & transaction_error_msg);
+	sqlite3_stmt * insert_into_witnesses_stmt;
+	rc = sqlite3_prepare(output_db, "INSERT INTO WITNESSES VALUES (?,?,?)", -1, & insert_into_witnesses_stmt, 0);
+	if (rc != SQLITE_OK) {
+		cerr << "Error preparing statement." << endl;
+		exit(1);
+	}
+	int row_id = 0;
+	for (string wit_id : list_wit) {
+		//Then insert a row containing these values:
+		sqlite3_bind_int(insert_into_witnesses_stmt, 1, row_id);
+		sqlite3_bind_text(insert_into_witnesses_stmt, 2, wit_id.c_str(), -1, SQLITE_STATIC);
+		sqlite3_bind_int(insert_into_witnesses_stmt, 3, extant_counts.at(wit_id));
+		rc = sqlite3_step(insert_into_witnesses_stmt);
+		if (rc != SQLITE_DONE) {
+			cerr << "Error executing prepared statement." << endl;
+			exit(1);
+		}
+		//Then reset the prepared statement so we can bind the next values to it:
+		sqlite3_reset(insert_into_witnesses_stmt);
+		row_id++;
+	}
+	sqlite3_finalize(insert_into_witnesses_stmt);
+	sqlite3_exec(output_db, "END TRANSACTION", NULL, NULL, & transaction_error_msg);
+	return;
+}
+
+/**
+ * Creates and populates the METADATA table, which records how the genealogical cache was calculated as key-value pairs.
+ * If the cache is one of several shards, then its shard is recorded under the SHARD key in the form i/N (counting from 1),
+ * so that merge_db can check that it has been given every shard exactly once.
+ * This table is small and is only read by key, so it is not indexed.
+ */
+void populate_metadata_table(sqlite3 * output_db, bool classic, const shard_spec & shard) {
+	int rc; //to store SQLite macros
+	//Create the METADATA table:
+	string create_metadata_sql = "DROP TABLE IF EXISTS METADATA;"
+			"CREATE TABLE METADATA ("
+			"KEY TEXT NOT NULL, "
+			"VALUE TEXT NOT NULL);";
+	char * create_metadata_error_msg;
+	rc = sqlite3_exec(output_db, create_metadata_sql.c_str(), NULL, 0, & create_metadata_error_msg);
+	if (rc != SQLITE_OK) {
+		cerr << "Error creating table METADATA: " << create_metadata_error_msg << endl;
+		sqlite3_free(create_metadata_error_msg);
+		exit(1);
+	}
+	//Then populate it:
+	sqlite3_stmt * insert_into_metadata_stmt;
+	rc = sqlite3_prepare(output_db, "INSERT INTO METADATA VALUES (?,?)", -1, & insert_into_metadata_stmt, 0);
+	if (rc != SQLITE_OK) {
+		cerr << "Error preparing statement." << endl;
+		exit(1);
+	}
+	sqlite3_bind_text(insert_into_metadata_stmt, 1, "CLASSIC", -1, SQLITE_STATIC);
+	sqlite3_bind_text(insert_into_metadata_stmt, 2, classic ? "1" : "0", -1, SQLITE_STATIC);
+	rc = sqlite3_step(insert_into_metadata_stmt);
+	if (rc != SQLITE_DONE) {
+		cerr << "Error executing prepared statement." << endl;
+		exit(1);
+	}
+	sqlite3_reset(insert_into_metadata_stmt);
+	if (shard.count > 1) {
+		string shard_value = to_string(shard.index + 1) + "/" + to_string(shard.count);
+		sqlite3_bind_text(insert_into_metadata_stmt, 1, "SHARD", -1, SQLITE_STATIC);
+		sqlite3_bind_text(insert_into_metadata_stmt, 2, shard_value.c_str(), -1, SQLITE_STATIC);
+		rc = sqlite3_step(insert_into_metadata_stmt);
+		if (rc != SQLITE_DONE) {
+			cerr << "Error executing prepared statement." << endl;
+			exit(1);
+		}
+		sqlite3_reset(insert_into_metadata_stmt);
+	}
+	//The generation of the cache is incremented whenever it is changed in place; see increment_cache_generation():
+	sqlite3_bind_text(insert_into_metadata_stmt, 1, "GENERATION", -1, SQLITE_STATIC);
+	sqlite3_bind_text(insert_into_metadata_stmt, 2, "0", -1, SQLITE_STATIC);
+	rc = sqlite3_step(insert_into_metadata_stmt);
+	if (rc != SQLITE_DONE) {
+		cerr << "Error executing prepared statement." << endl;
+		exit(1);
+	}
+	sqlite3_finalize(insert_into_metadata_stmt);
+	return;
+}
+
+/**
+ * Increments the GENERATION entry of the METADATA table of the given database, adding it if the cache predates it.
+ * This is done by every run that changes the cache in place, even if it finds nothing to change,
+ * so that any snapshot written before the run no longer matches the cache's fingerprint and is refused as out of date.
+ */
+void increment_cache_generation(sqlite3 * output_db) {
+	int rc; //to store SQLite macros
+	char * update_metadata_error_msg;
+	rc = sqlite3_exec(output_db, "UPDATE METADATA SET VALUE=CAST(CAST(VALUE AS INTEGER) + 1 AS TEXT) WHERE KEY='GENERATION';", NULL, 0, & update_metadata_error_msg);
+	if (rc == SQLITE_OK && sqlite3_changes(output_db) == 0) {
+		rc = sqlite3_exec(output_db, "INSERT INTO METADATA VALUES ('GENERATION','1');", NULL, 0, & update_metadata_error_msg);
+	}
+	if (rc != SQLITE_OK) {
+		cerr << "Error updating table METADATA: " << update_metadata_error_msg << endl;
+		sqlite3_free(update_metadata_error_msg);
+		exit(1);
+	}
+	return;
+}
+
+/**
+ * Returns the value stored under the given key in the METADATA table of the given database.
+ * Exits with an error if the table or key does not exist.
+ */
+string get_metadata_value(sqlite3 * output_db, const string & key) {
+	int rc; //to store SQLite macros
+	sqlite3_stmt * select_from_metadata_stmt;
+	rc = sqlite3_prepare(output_db, "SELECT VALUE FROM METADATA WHERE KEY=?", -1, & select_from_metadata_stmt, 0);
+	if (rc != SQLITE_OK) {
+		cerr << "Error: the database has no METADATA table, so it was populated by an older version of populate_db and cannot be updated; please repopulate it." << endl;
+		exit(1);
+	}
+	sqlite3_bind_text(select_from_metadata_stmt, 1, key.c_str(), -1, SQLITE_STATIC);
+	rc = sqlite3_step(select_from_metadata_stmt);
+	if (rc != SQLITE_ROW) {
+		cerr << "Error: the database's METADATA table has no value for " << key << "." << endl;
+		exit(1);
+	}
+	string value = string(reinterpret_cast<const char *>(sqlite3_column_text(select_from_metadata_stmt, 0)));
+	sqlite3_finalize(select_from_metadata_stmt);
+	return value;
+}
+
+/**
+ * Exits with an error if the genealogical cache in the given database was not calculated under the requested rules (classic or standard).
+ */
+void check_cached_rules(sqlite3 * output_db, bool classic) {
+	bool cached_classic = get_metadata_value(output_db, "CLASSIC") == "1";
+	if (cached_classic != classic) {
+		cerr << "Error: the database was populated " << (cached_classic ? "with" : "without") << " the --classic option, so populate_db must be run " << (cached_classic ? "with" : "without") << " it here as well." << endl;
+		exit(1);
+	}
+	return;
+}
+
+/**
+ * Returns the shard recorded in the METADATA table of the given database in the form i/N,
+ * or an empty string if the database holds a complete genealogical cache.
+ */
+string get_cached_shard(sqlite3 * output_db) {
+	string shard_value = string();
+	sqlite3_stmt * select_from_metadata_stmt;
+	sqlite3_prepare(output_db, "SELECT VALUE FROM METADATA WHERE KEY='SHARD'", -1, & select_from_metadata_stmt, 0);
+	if (sqlite3_step(select_from_metadata_stmt) == SQLITE_ROW) {
+		shard_value = string(reinterpret_cast<const char *>(sqlite3_column_text(select_from_metadata_stmt, 0)));
+	}
+	sqlite3_finalize(select_from_metadata_stmt);
+	return shard_value;
+}
+
+/**
+ * Returns the content hashes stored in the VARIATION_UNITS table of the given database, in order.
+ * Exits with an error if the variation units in the table do not match the given ones in number and order.
+ */
+vector<string> read_cached_hashes(sqlite3 * output_db, const vector<variation_unit> & variation_units) {
+	int rc; //to store SQLite macros
+	vector<string> cached_vu_ids = vector<string>();
+	vector<string> cached_hashes = vector<string>();
+	sqlite3_stmt * select_from_variation_units_stmt;
+	rc = sqlite3_prepare(output_db, "SELECT VARIATION_UNIT, HASH FROM VARIATION_UNITS ORDER BY ROW_ID", -1, & select_from_variation_units_stmt, 0);
+	if (rc != SQLITE_OK) {
+		cerr << "Error: the database's VARIATION_UNITS table has no HASH column, so it was populated by an older version of populate_db and cannot be updated; please repopulate it." << endl;
+		exit(1);
+	}
+	rc = sqlite3_step(select_from_variation_units_stmt);
+	while (rc == SQLITE_ROW) {
+		cached_vu_ids.push_back(string(reinterpret_cast<const char *>(sqlite3_column_text(select_from_variation_units_stmt, 0))));
+		cached_hashes.push_back(string(reinterpret_cast<const char *>(sqlite3_column_text(select_from_variation_units_stmt, 1))));
+		rc = sqlite3_step(select_from_variation_units_stmt);
+	}
+	sqlite3_finalize(select_from_variation_units_stmt);
+	if (cached_vu_ids.size() != variation_units.size()) {
+		cerr << "Error: the number of variation units has changed, so the database must be repopulated." << endl;
+		exit(1);
+	}
+	for (unsigned int vu_ind = 0; vu_ind < (unsigned int) variation_units.size(); vu_ind++) {
+		if (variation_units[vu_ind].get_id() != cached_vu_ids[vu_ind]) {
+			cerr << "Error: the list of variation units has changed (expected " << cached_vu_ids[vu_ind] << " but found " << variation_units[vu_ind].get_id() << "), so the database must be repopulated." << endl;
+			exit(1);
+		}
+	}
+	return cached_hashes;
+}
+
+/**
+ * Returns the ID to assign to the next row of the given table: one more than its largest existing row ID, or 0 if it is empty.
+ */
+sqlite3_int64 get_next_row_id(sqlite3 * output_db, const string & table_name) {
+	sqlite3_int64 row_id = 0;
+	string select_max_row_id_sql = "SELECT COALESCE(MAX(ROW_ID) + 1, 0) FROM " + table_name;
+	sqlite3_stmt * select_max_row_id_stmt;
+	sqlite3_prepare(output_db, select_max_row_id_sql.c_str(), -1, & select_max_row_id_stmt, 0);
+	if (sqlite3_step(select_max_row_id_stmt) == SQLITE_ROW) {
+		row_id = sqlite3_column_int64(select_max_row_id_stmt, 0);
+	}
+	sqlite3_finalize(select_max_row_id_stmt);
+	return row_id;
+}
+
+/**
+ * Returns true if the readings of the given variation unit and the readings of the given witnesses there
+ * match those stored in the READINGS and READING_SUPPORT tables of the given database.
+ */
+bool reading_data_matches(sqlite3 * output_db, const variation_unit & vu, const list<string> & list_wit) {
+	int rc; //to store SQLite macros
+	string vu_id = vu.get_id();
+	//Compare the unit's readings:
+	list<string> cached_readings = list<string>();
+	sqlite3_stmt * select_from_readings_stmt;
+	sqlite3_prepare(output_db, "SELECT READING FROM READINGS WHERE VARIATION_UNIT=? ORDER BY ROW_ID", -1, & select_from_readings_stmt, 0);
+	sqlite3_bind_text(select_from_readings_stmt, 1, vu_id.c_str(), -1, SQLITE_STATIC);
+	rc = sqlite3_step(select_from_readings_stmt);
+	while (rc == SQLITE_ROW) {
+		cached_readings.push_back(string(reinterpret_cast<const char *>(sqlite3_column_text(select_from_readings_stmt, 0))));
+		rc = sqlite3_step(select_from_readings_stmt);
+	}
+	sqlite3_finalize(select_from_readings_stmt);
+	if (cached_readings != vu.get_readings()) {
+		return false;
+	}
+	//Then compare the readings supported by the witnesses in the witness list:
+	unordered_map<string, string> cached_reading_support = unordered_map<string, string>();
+	sqlite3_stmt * select_from_reading_support_stmt;
+	sqlite3_prepare(output_db, "SELECT WITNESS, READING FROM READING_SUPPORT WHERE VARIATION_UNIT=?", -1, & select_from_reading_support_stmt, 0);
+	sqlite3_bind_text(select_from_reading_support_stmt, 1, vu_id.c_str(), -1, SQLITE_STATIC);
+	rc = sqlite3_step(select_from_reading_support_stmt);
+	while (rc == SQLITE_ROW) {
+		string wit_id = string(reinterpret_cast<const char *>(sqlite3_column_text(select_from_reading_support_stmt, 0)));
+		string wit_rdg = string(reinterpret_cast<const char *>(sqlite3_column_text(select_from_reading_support_stmt, 1)));
+		cached_reading_support[wit_id] = wit_rdg;
+		rc = sqlite3_step(select_from_reading_support_stmt);
+	}
+	sqlite3_finalize(select_from_reading_support_stmt);
+	unordered_map<string, string> reading_support = vu.get_reading_support();
+	unordered_map<string, string> wit_reading_support = unordered_map<string, string>();
+	for (const string & wit_id : list_wit) {
+		if (reading_support.find(wit_id) != reading_support.end()) {
+			wit_reading_support[wit_id] = reading_support.at(wit_id);
+		}
+	}
+	return cached_reading_support == wit_reading_support;
+}
+
+/**
+ * Replaces the rows of the READING_RELATIONS table for the given variation unit with the edges of its current local stemma,
+ * and updates its row in the VARIATION_UNITS table with its current label, connectivity, and content hash.
+ */
+void update_variation_unit_rows(sqlite3 * output_db, const variation_unit & vu, const string & hash) {
+	int rc; //to store SQLite macros
+	string vu_id = vu.get_id();
+	sqlite3_stmt * delete_from_reading_relations_stmt;
+	sqlite3_prepare(output_db, "DELETE FROM READING_RELATIONS WHERE VARIATION_UNIT=?", -1, & delete_from_reading_relations_stmt, 0);
+	sqlite3_bind_text(delete_from_reading_relations_stmt, 1, vu_id.c_str(), -1, SQLITE_STATIC);
+	rc = sqlite3_step(delete_from_reading_relations_stmt);
+	if (rc != SQLITE_DONE) {
+		cerr << "Error executing prepared statement." << endl;
 		exit(1);
 	}
-	//Denormalize it:
-	string create_genealogical_comparisons_idx_sql = "DROP INDEX IF EXISTS GENEALOGICAL_COMPARISONS_IDX;"
-			"CREATE INDEX GENEALOGICAL_COMPARISONS_IDX ON GENEALOGICAL_COMPARISONS (PRIMARY_WIT, SECONDARY_WIT);";
-	char * create_genealogical_comparisons_idx_error_msg;
-	rc = sqlite3_exec(output_db, create_genealogical_comparisons_idx_sql.c_str(), NULL, 0, & create_genealogical_comparisons_idx_error_msg);
+	sqlite3_finalize(delete_from_reading_relations_stmt);
+	//New rows are numbered after all existing rows:
+	sqlite3_int64 row_id = get_next_row_id(output_db, "READING_RELATIONS");
+	sqlite3_stmt * insert_into_reading_relations_stmt;
+	rc = sqlite3_prepare(output_db, "INSERT INTO READING_RELATIONS VALUES (?,?,?,?,?)", -1, & insert_into_reading_relations_stmt, 0);
 	if (rc != SQLITE_OK) {
-		cerr << "Error creating index GENEALOGICAL_COMPARISONS_IDX: " << create_genealogical_comparisons_idx_error_msg << endl;
-		sqlite3_free(create_genealogical_comparisons_idx_error_msg);
+		cerr << "Error preparing statement." << endl;
 		exit(1);
 	}
-	//Then populate it using prepared statements within a single transaction:
-	char * transaction_error_msg;
-	sqlite3_exec(output_db, "BEGIN TRANSACTION", NULL, NULL, & transaction_error_msg);
-	sqlite3_stmt * insert_into_genealogical_comparisons_stmt;
-	rc = sqlite3_prepare(output_db, "INSERT INTO GENEALOGICAL_COMPARISONS VALUES (?,?,?,?,?,?,?,?,?,?,?)", -1, & insert_into_genealogical_comparisons_stmt, 0);
+	for (const local_stemma_edge & e : vu.get_local_stemma().get_edges()) {
+		sqlite3_bind_int64(insert_into_reading_relations_stmt, 1, row_id);
+		sqlite3_bind_text(insert_into_reading_relations_stmt, 2, vu_id.c_str(), -1, SQLITE_STATIC);
+		sqlite3_bind_text(insert_into_reading_relations_stmt, 3, e.prior.c_str(), -1, SQLITE_STATIC);
+		sqlite3_bind_text(insert_into_reading_relations_stmt, 4, e.posterior.c_str(), -1, SQLITE_STATIC);
+		sqlite3_bind_double(insert_into_reading_relations_stmt, 5, e.weight);
+		rc = sqlite3_step(insert_into_reading_relations_stmt);
+		if (rc != SQLITE_DONE) {
+			cerr << "Error executing prepared statement." << endl;
+			exit(1);
+		}
+		sqlite3_reset(insert_into_reading_relations_stmt);
+		row_id++;
+	}
+	sqlite3_finalize(insert_into_reading_relations_stmt);
+	string label = vu.get_label();
+	sqlite3_stmt * update_variation_units_stmt;
+	sqlite3_prepare(output_db, "UPDATE VARIATION_UNITS SET LABEL=?, CONNECTIVITY=?, HASH=? WHERE VARIATION_UNIT=?", -1, & update_variation_units_stmt, 0);
+	sqlite3_bind_text(update_variation_units_stmt, 1, label.c_str(), -1, SQLITE_STATIC);
+	sqlite3_bind_int(update_variation_units_stmt, 2, vu.get_connectivity());
+	sqlite3_bind_text(update_variation_units_stmt, 3, hash.c_str(), -1, SQLITE_STATIC);
+	sqlite3_bind_text(update_variation_units_stmt, 4, vu_id.c_str(), -1, SQLITE_STATIC);
+	rc = sqlite3_step(update_variation_units_stmt);
+	if (rc != SQLITE_DONE) {
+		cerr << "Error executing prepared statement." << endl;
+		exit(1);
+	}
+	sqlite3_finalize(update_variation_units_stmt);
+	return;
+}
+
+/**
+ * A genealogical comparison read from the database whose relationship bitmaps and cost are being patched.
+ */
+struct patched_comparison {
+	sqlite3_int64 rowid;
+	unsigned int primary_wit_ind;
+	unsigned int secondary_wit_ind;
+	Roaring prior;
+	Roaring posterior;
+	Roaring norel;
+	Roaring unclear;
+	Roaring explained;
+	float cost;
+};
+
+/**
+ * Patches the rows of the GENEALOGICAL_COMPARISONS table at the variation units with the given indices, whose local stemmata have changed.
+ * For every pair of witnesses that are both extant and disagree at one of these units,
+ * the unit's bit is cleared from the prior, posterior, norel, unclear, and explained bitmaps and set again according to the unit's new local stemma (as held by the given engine),
+ * the counts of these bitmaps are updated to match, and the cost is recalculated by the engine, so that it is exactly the cost of a freshly populated cache.
+ * Pairs that agree, and the extant and agreements bitmaps, do not depend on the local stemma and are left alone.
+ * The table is scanned in batches of rows so that it is never modified while a scan of it is in progress;
+ * the scan only reads the witnesses of each row, and the bitmaps are only read for the rows that need to be patched.
+ * Returns the number of rows that were patched.
+ */
+unsigned long long patch_genealogical_comparisons(sqlite3 * output_db, const comparison_engine & engine, const vector<unsigned int> & changed_vu_inds) {
+	const int batch_size = 4096;
+	int rc; //to store SQLite macros
+	vector<string> list_wit = engine.get_list_wit();
+	unordered_map<string, unsigned int> wit_inds = unordered_map<string, unsigned int>();
+	for (unsigned int wit_ind = 0; wit_ind < (unsigned int) list_wit.size(); wit_ind++) {
+		wit_inds[list_wit[wit_ind]] = wit_ind;
+	}
+	sqlite3_stmt * select_from_genealogical_comparisons_stmt;
+	rc = sqlite3_prepare(output_db, "SELECT rowid, PRIMARY_WIT, SECONDARY_WIT FROM GENEALOGICAL_COMPARISONS WHERE rowid>? ORDER BY rowid LIMIT ?", -1, & select_from_genealogical_comparisons_stmt, 0);
 	if (rc != SQLITE_OK) {
 		cerr << "Error preparing statement." << endl;
 		exit(1);
 	}
-	int row_id = 0;
-	for (witness primary_wit : witnesses) {
-		string primary_wit_id = primary_wit.get_id();
-		for (witness secondary_wit : witnesses) {
-			string secondary_wit_id = secondary_wit.get_id();
-			genealogical_comparison comp = primary_wit.get_genealogical_comparison_for_witness(secondary_wit_id);
-			//Serialize the bitmaps into byte arrays:
-			Roaring extant = comp.extant;
-			int extant_expected_size = (int) extant.getSizeInBytes();
-			char * extant_buf = new char [extant_expected_size];
-			extant.write(extant_buf);
-			Roaring agreements = comp.agreements;
-			int agreements_expected_size = (int) agreements.getSizeInBytes();
-			char * agreements_buf = new char [agreements_expected_size];
-			agreements.write(agreements_buf);
-			Roaring prior = comp.prior;
-			int prior_expected_size = (int) prior.getSizeInBytes();
-			char * prior_buf = new char [prior_expected_size];
-			prior.write(prior_buf);
-			Roaring posterior = comp.posterior;
-			int posterior_expected_size = (int) posterior.getSizeInBytes();
-			char * posterior_buf = new char [posterior_expected_size];
-			posterior.write(posterior_buf);
-			Roaring norel = comp.norel;
-			int norel_expected_size = (int) norel.getSizeInBytes();
-			char * norel_buf = new char [norel_expected_size];
-			norel.write(norel_buf);
-			Roaring unclear = comp.unclear;
-			int unclear_expected_size = (int) unclear.getSizeInBytes();
-			char * unclear_buf = new char [unclear_expected_size];
-			unclear.write(unclear_buf);
-			Roaring explained = comp.explained;
-			int explained_expected_size = (int) explained.getSizeInBytes();
-			char * explained_buf = new char [explained_expected_size];
-			explained.write(explained_buf);
-			//Get the genealogical cost:
-			float cost = comp.cost;
-			//Then insert a row containing these values:
-			sqlite3_bind_int(insert_into_genealogical_comparisons_stmt, 1, row_id);
-			sqlite3_bind_text(insert_into_genealogical_comparisons_stmt, 2, primary_wit_id.c_str(), -1, SQLITE_STATIC);
-			sqlite3_bind_text(insert_into_genealogical_comparisons_stmt, 3, secondary_wit_id.c_str(), -1, SQLITE_STATIC);
-			sqlite3_bind_blob(insert_into_genealogical_comparisons_stmt, 4, extant_buf, extant_expected_size, SQLITE_STATIC);
-			sqlite3_bind_blob(insert_into_genealogical_comparisons_stmt, 5, agreements_buf, agreements_expected_size, SQLITE_STATIC);
-			sqlite3_bind_blob(insert_into_genealogical_comparisons_stmt, 6, prior_buf, prior_expected_size, SQLITE_STATIC);
-			sqlite3_bind_blob(insert_into_genealogical_comparisons_stmt, 7, posterior_buf, posterior_expected_size, SQLITE_STATIC);
-			sqlite3_bind_blob(insert_into_genealogical_comparisons_stmt, 8, norel_buf, norel_expected_size, SQLITE_STATIC);
-			sqlite3_bind_blob(insert_into_genealogical_comparisons_stmt, 9, unclear_buf, unclear_expected_size, SQLITE_STATIC);
-			sqlite3_bind_blob(insert_into_genealogical_comparisons_stmt, 10, explained_buf, explained_expected_size, SQLITE_STATIC);
-			sqlite3_bind_double(insert_into_genealogical_comparisons_stmt, 11, cost);
-			rc = sqlite3_step(insert_into_genealogical_comparisons_stmt);
+	sqlite3_stmt * select_bitmaps_from_genealogical_comparisons_stmt;
+	rc = sqlite3_prepare(output_db, "SELECT PRIOR, POSTERIOR, NOREL, UNCLEAR, EXPLAINED FROM GENEALOGICAL_COMPARISONS WHERE rowid=?", -1, & select_bitmaps_from_genealogical_comparisons_stmt, 0);
+	if (rc != SQLITE_OK) {
+		cerr << "Error preparing statement." << endl;
+		exit(1);
+	}
+	sqlite3_stmt * update_genealogical_comparisons_stmt;
+	rc = sqlite3_prepare(output_db, "UPDATE GENEALOGICAL_COMPARISONS SET PRIOR=?, POSTERIOR=?, NOREL=?, UNCLEAR=?, EXPLAINED=?, PRIOR_COUNT=?, POSTERIOR_COUNT=?, NOREL_COUNT=?, UNCLEAR_COUNT=?, EXPLAINED_COUNT=?, COST=? WHERE rowid=?", -1, & update_genealogical_comparisons_stmt, 0);
+	if (rc != SQLITE_OK) {
+		cerr << "Error preparing statement." << endl;
+		exit(1);
+	}
+	unsigned long long num_patched = 0;
+	vector<char> scratch = vector<char>();
+	sqlite3_int64 last_rowid = 0;
+	int num_rows = batch_size;
+	while (num_rows == batch_size) {
+		//Find the rows in a batch that need to be patched:
+		vector<patched_comparison> patched = vector<patched_comparison>();
+		num_rows = 0;
+		sqlite3_bind_int64(select_from_genealogical_comparisons_stmt, 1, last_rowid);
+		sqlite3_bind_int(select_from_genealogical_comparisons_stmt, 2, batch_size);
+		rc = sqlite3_step(select_from_genealogical_comparisons_stmt);
+		while (rc == SQLITE_ROW) {
+			num_rows++;
+			last_rowid = sqlite3_column_int64(select_from_genealogical_comparisons_stmt, 0);
+			string primary_wit_id = string(reinterpret_cast<const char *>(sqlite3_column_text(select_from_genealogical_comparisons_stmt, 1)));
+			string secondary_wit_id = string(reinterpret_cast<const char *>(sqlite3_column_text(select_from_genealogical_comparisons_stmt, 2)));
+			unsigned int primary_wit_ind = wit_inds.at(primary_wit_id);
+			unsigned int secondary_wit_ind = wit_inds.at(secondary_wit_id);
+			for (unsigned int vu_ind : changed_vu_inds) {
+				int primary_rdg_code = engine.get_reading_code(vu_ind, primary_wit_ind);
+				int secondary_rdg_code = engine.get_reading_code(vu_ind, secondary_wit_ind);
+				if (primary_rdg_code >= 0 && secondary_rdg_code >= 0 && primary_rdg_code != secondary_rdg_code) {
+					patched_comparison comp;
+					comp.rowid = last_rowid;
+					comp.primary_wit_ind = primary_wit_ind;
+					comp.secondary_wit_ind = secondary_wit_ind;
+					patched.push_back(comp);
+					break;
+				}
+			}
+			rc = sqlite3_step(select_from_genealogical_comparisons_stmt);
+		}
+		sqlite3_reset(select_from_genealogical_comparisons_stmt);
+		//Then read, patch, and write back each of these rows:
+		for (patched_comparison & comp : patched) {
+			sqlite3_bind_int64(select_bitmaps_from_genealogical_comparisons_stmt, 1, comp.rowid);
+			rc = sqlite3_step(select_bitmaps_from_genealogical_comparisons_stmt);
+			if (rc != SQLITE_ROW) {
+				cerr << "Error executing prepared statement." << endl;
+				exit(1);
+			}
+			Roaring * bitmaps[5] = {& comp.prior, & comp.posterior, & comp.norel, & comp.unclear, & comp.explained};
+			for (int i = 0; i < 5; i++) {
+				const char * buf = reinterpret_cast<const char *>(sqlite3_column_blob(select_bitmaps_from_genealogical_comparisons_stmt, i));
+				size_t bytes = sqlite3_column_bytes(select_bitmaps_from_genealogical_comparisons_stmt, i);
+				* bitmaps[i] = Roaring::readSafe(buf, bytes);
+			}
+			sqlite3_reset(select_bitmaps_from_genealogical_comparisons_stmt);
+			for (unsigned int vu_ind : changed_vu_inds) {
+				reading_relation rel;
+				if (!engine.relate_witnesses(vu_ind, comp.primary_wit_ind, comp.secondary_wit_ind, rel) || rel.type == AGREE) {
+					continue;
+				}
+				//Clear the unit's old relationship:
+				comp.prior.remove(vu_ind);
+				comp.posterior.remove(vu_ind);
+				comp.norel.remove(vu_ind);
+				comp.unclear.remove(vu_ind);
+				comp.explained.remove(vu_ind);
+				//Then set its new one:
+				switch (rel.type) {
+					case PRIOR:
+						comp.prior.add(vu_ind);
+						break;
+					case POSTERIOR:
+						comp.posterior.add(vu_ind);
+						break;
+					case NOREL:
+						comp.norel.add(vu_ind);
+						break;
+					case UNCLEAR:
+						comp.unclear.add(vu_ind);
+						break;
+					default:
+						break;
+				}
+				if (rel.explained) {
+					comp.explained.add(vu_ind);
+				}
+			}
+			comp.cost = engine.get_cost(comp.primary_wit_ind, comp.secondary_wit_ind);
+			size_t sizes[5];
+			size_t total_size = 0;
+			for (int i = 0; i < 5; i++) {
+				bitmaps[i]->runOptimize();
+				sizes[i] = bitmaps[i]->getSizeInBytes();
+				total_size += sizes[i];
+			}
+			if (scratch.size() < total_size) {
+				scratch.resize(total_size);
+			}
+			size_t offset = 0;
+			for (int i = 0; i < 5; i++) {
+				bitmaps[i]->write(scratch.data() + offset);
+				sqlite3_bind_blob(update_genealogical_comparisons_stmt, 1 + i, scratch.data() + offset, (int) sizes[i], SQLITE_STATIC);
+				sqlite3_bind_int64(update_genealogical_comparisons_stmt, 6 + i, (sqlite3_int64) bitmaps[i]->cardinality());
+				offset += sizes[i];
+			}
+			sqlite3_bind_double(update_genealogical_comparisons_stmt, 11, comp.cost);
+			sqlite3_bind_int64(update_genealogical_comparisons_stmt, 12, comp.rowid);
+			rc = sqlite3_step(update_genealogical_comparisons_stmt);
 			if (rc != SQLITE_DONE) {
 				cerr << "Error executing prepared statement." << endl;
-				delete[] extant_buf;
-				delete[] agreements_buf;
-				delete[] prior_buf;
-				delete[] posterior_buf;
-				delete[] norel_buf;
-				delete[] unclear_buf;
-				delete[] explained_buf;
 				exit(1);
 			}
-			//Then clean up allocated memory and reset the prepared statement so we can bind the next values to it:
-			delete[] extant_buf;
-			delete[] agreements_buf;
-			delete[] prior_buf;
-			delete[] posterior_buf;
-			delete[] norel_buf;
-			delete[] unclear_buf;
-			delete[] explained_buf;
-			sqlite3_reset(insert_into_genealogical_comparisons_stmt);
-			row_id++;
+			sqlite3_reset(update_genealogical_comparisons_stmt);
+			num_patched++;
 		}
 	}
-	sqlite3_finalize(insert_into_genealogical_comparisons_stmt);
-	sqlite3_exec(output_db, "END TRANSACTION", NULL, NULL, & transaction_error_msg);
+	sqlite3_finalize(select_from_genealogical_comparisons_stmt);
+	sqlite3_finalize(select_bitmaps_from_genealogical_comparisons_stmt);
+	sqlite3_finalize(update_genealogical_comparisons_stmt);
+	return num_patched;
+}
+
+/**
+ * Updates an existing genealogical cache in the given database to match the given apparatus,
+ * rewriting only the data for the variation units whose content hashes have changed.
+ * This is only possible when the witness list, the list of variation units, and each unit's readings and reading support are unchanged
+ * and the cache was populated under the same rules (classic or standard) as those requested;
+ * otherwise, the database must be repopulated from scratch, and this function exits with an error saying so.
+ */
+void update_genealogical_cache(sqlite3 * output_db, const apparatus & app, bool classic) {
+	check_cached_rules(output_db, classic);
+	cache_reader reader(output_db);
+	//Check that the witness list is unchanged:
+	list<string> list_wit = app.get_list_wit();
+	if (reader.get_list_wit() != list_wit) {
+		cerr << "Error: the list of witnesses has changed, so the database must be repopulated." << endl;
+		exit(1);
+	}
+	//Check that the list of variation units is unchanged, and find the units whose contents have changed:
+	vector<variation_unit> variation_units = app.get_variation_units();
+	vector<string> cached_hashes = read_cached_hashes(output_db, variation_units);
+	vector<unsigned int> changed_vu_inds = vector<unsigned int>();
+	vector<string> changed_hashes = vector<string>();
+	for (unsigned int vu_ind = 0; vu_ind < (unsigned int) variation_units.size(); vu_ind++) {
+		const variation_unit & vu = variation_units[vu_ind];
+		string hash = get_variation_unit_hash(vu, list_wit);
+		if (hash != cached_hashes[vu_ind]) {
+			changed_vu_inds.push_back(vu_ind);
+			changed_hashes.push_back(hash);
+		}
+	}
+	if (changed_vu_inds.empty()) {
+		cout << "No variation units have changed; the database is already up to date." << endl;
+		return;
+	}
+	cout << changed_vu_inds.size() << " of " << variation_units.size() << " variation units have changed." << endl;
+	//Apply all of the changes within a single transaction, so that a failed update leaves the database as it was:
+	execute_sql(output_db, "BEGIN TRANSACTION");
+	//The updated cache can no longer be resumed as the run that populated it:
+	drop_comparison_progress_table(output_db);
+	cout << "Updating tables READING_RELATIONS and VARIATION_UNITS..." << endl;
+	for (unsigned int i = 0; i < (unsigned int) changed_vu_inds.size(); i++) {
+		const variation_unit & vu = variation_units[changed_vu_inds[i]];
+		if (!reading_data_matches(output_db, vu, list_wit)) {
+			cerr << "Error: the readings or reading support of variation unit " << vu.get_id() << " have changed, so the database must be repopulated." << endl;
+			exit(1);
+		}
+		update_variation_unit_rows(output_db, vu, changed_hashes[i]);
+	}
+	cout << "Updating table GENEALOGICAL_COMPARISONS..." << endl;
+	comparison_engine engine = comparison_engine(app, classic);
+	unsigned long long num_patched = patch_genealogical_comparisons(output_db, engine, changed_vu_inds);
+	execute_sql(output_db, "END TRANSACTION");
+	cout << "Updated " << num_patched << " genealogical comparisons." << endl;
 	return;
 }
 
 /**
- * Creates, indexes, and populates the WITNESSES table.
+ * Adds the witnesses in the given apparatus that are not yet in the genealogical cache in the given database to it.
+ * New witnesses are appended to the cache's witness list in the order in which they appear in the apparatus,
+ * and only the comparisons involving at least one new witness are calculated, using the given number of threads and memory budget (in bytes, or 0 for none).
+ * Their rows in GENEALOGICAL_COMPARISONS are numbered after all existing rows, so that sorting a primary witness's rows by ID still follows the witness list.
+ * Witnesses with identical readings are not collapsed here (see get_duplicate_witnesses()): every comparison involving a new witness is calculated in full.
+ * This is only possible when the existing witnesses, the list of variation units, and each unit's readings, local stemma,
+ * and reading support for the existing witnesses are unchanged and the cache was populated under the same rules as those requested,
+ * and when the cache is complete rather than one shard of it;
+ * otherwise, this function exits with an error explaining why the database must be updated or repopulated instead.
  */
-void populate_witnesses_table(sqlite3 * output_db, const list<string> & list_wit) {
+void add_witnesses_to_cache(sqlite3 * output_db, apparatus app, const unordered_map<string, int> & extant_counts, bool classic, unsigned int num_threads, unsigned long long max_memory) {
 	int rc; //to store SQLite macros
-	//Create the WITNESSES table:
-	string create_witnesses_sql = "DROP TABLE IF EXISTS WITNESSES;"
-			"CREATE TABLE WITNESSES ("
-			"ROW_ID INT NOT NULL, "
-			"WITNESS TEXT NOT NULL);";
-	char * create_witnesses_error_msg;
-	rc = sqlite3_exec(output_db, create_witnesses_sql.c_str(), NULL, 0, & create_witnesses_error_msg);
-	if (rc != SQLITE_OK) {
-		cerr << "Error creating table WITNESSES: " << create_witnesses_error_msg << endl;
-		sqlite3_free(create_witnesses_error_msg);
+	check_cached_rules(output_db, classic);
+	if (!get_cached_shard(output_db).empty()) {
+		cerr << "Error: the database holds only one shard of a genealogical cache; please merge the shards with merge_db before adding witnesses." << endl;
 		exit(1);
 	}
-	//Denormalize it:
-	string create_witnesses_idx_sql = "DROP INDEX IF EXISTS WITNESSES_IDX;"
-			"CREATE INDEX WITNESSES_IDX ON WITNESSES (WITNESS);";
-	char * create_witnesses_idx_error_msg;
-	rc = sqlite3_exec(output_db, create_witnesses_idx_sql.c_str(), NULL, 0, & create_witnesses_idx_error_msg);
-	if (rc != SQLITE_OK) {
-		cerr << "Error creating index WITNESSES_IDX: " << create_witnesses_idx_error_msg << endl;
-		sqlite3_free(create_witnesses_idx_error_msg);
-		exit(1);
+	//Check that every cached witness is still present, and find the new witnesses:
+	cache_reader reader(output_db);
+	list<string> cached_list_wit = reader.get_list_wit();
+	set<string> cached_wits = set<string>(cached_list_wit.begin(), cached_list_wit.end());
+	set<string> app_wits = set<string>();
+	list<string> new_list_wit = list<string>();
+	for (const string & wit_id : app.get_list_wit()) {
+		app_wits.insert(wit_id);
+		if (cached_wits.find(wit_id) == cached_wits.end()) {
+			new_list_wit.push_back(wit_id);
+		}
 	}
-	//Then populate it using prepared statements within a single transaction:
-	char * transaction_error_msg;
-	sqlite3_exec(output_db, "BEGIN TRANSACTION", NULL, NULL, & transaction_error_msg);
+	for (const string & wit_id : cached_list_wit) {
+		if (app_wits.find(wit_id) == app_wits.end()) {
+			cerr << "Error: witness " << wit_id << " is in the database but not in the collation, so the database must be repopulated." << endl;
+			exit(1);
+		}
+	}
+	if (new_list_wit.empty()) {
+		cout << "No new witnesses were found; the database is already up to date." << endl;
+		return;
+	}
+	//Check that nothing else about the variation units has changed, as seen from the existing witnesses:
+	vector<variation_unit> variation_units = app.get_variation_units();
+	vector<string> cached_hashes = read_cached_hashes(output_db, variation_units);
+	for (unsigned int vu_ind = 0; vu_ind < (unsigned int) variation_units.size(); vu_ind++) {
+		if (get_variation_unit_hash(variation_units[vu_ind], cached_list_wit) != cached_hashes[vu_ind]) {
+			cerr << "Error: variation unit " << variation_units[vu_ind].get_id() << " has changed apart from its new witnesses; please run populate_db with the --update option first, or repopulate the database." << endl;
+			exit(1);
+		}
+	}
+	cout << "Adding " << new_list_wit.size() << " new witnesses to the database..." << endl;
+	//The new witnesses follow the existing ones:
+	list<string> list_wit = cached_list_wit;
+	list_wit.insert(list_wit.end(), new_list_wit.begin(), new_list_wit.end());
+	app.set_list_wit(list_wit);
+	//Apply all of the changes within a single transaction, so that a failed update leaves the database as it was:
+	execute_sql(output_db, "BEGIN TRANSACTION");
+	//The progress of the run that populated the cache is recorded in the indices of the old witness list, so it cannot be resumed after this:
+	drop_comparison_progress_table(output_db);
+	cout << "Updating table WITNESSES..." << endl;
+	sqlite3_int64 row_id = get_next_row_id(output_db, "WITNESSES");
 	sqlite3_stmt * insert_into_witnesses_stmt;
-	rc = sqlite3_prepare(output_db, "INSERT INTO WITNESSES VALUES (?,?)", -1, & insert_into_witnesses_stmt, 0);
+	rc = sqlite3_prepare(output_db, "INSERT INTO WITNESSES VALUES (?,?,?)", -1, & insert_into_witnesses_stmt, 0);
 	if (rc != SQLITE_OK) {
 		cerr << "Error preparing statement." << endl;
 		exit(1);
 	}
-	int row_id = 0;
-	for (string wit_id : list_wit) {
-		//Then insert a row containing these values:
-		sqlite3_bind_int(insert_into_witnesses_stmt, 1, row_id);
+	for (const string & wit_id : new_list_wit) {
+		sqlite3_bind_int64(insert_into_witnesses_stmt, 1, row_id);
 		sqlite3_bind_text(insert_into_witnesses_stmt, 2, wit_id.c_str(), -1, SQLITE_STATIC);
+		sqlite3_bind_int(insert_into_witnesses_stmt, 3, extant_counts.at(wit_id));
 		rc = sqlite3_step(insert_into_witnesses_stmt);
 		if (rc != SQLITE_DONE) {
 			cerr << "Error executing prepared statement." << endl;
 			exit(1);
 		}
-		//Then reset the prepared statement so we can bind the next values to it:
 		sqlite3_reset(insert_into_witnesses_stmt);
 		row_id++;
 	}
 	sqlite3_finalize(insert_into_witnesses_stmt);
-	sqlite3_exec(output_db, "END TRANSACTION", NULL, NULL, & transaction_error_msg);
+	cout << "Updating tables READING_SUPPORT and VARIATION_UNITS..." << endl;
+	row_id = get_next_row_id(output_db, "READING_SUPPORT");
+	sqlite3_stmt * insert_into_reading_support_stmt;
+	rc = sqlite3_prepare(output_db, "INSERT INTO READING_SUPPORT VALUES (?,?,?,?)", -1, & insert_into_reading_support_stmt, 0);
+	if (rc != SQLITE_OK) {
+		cerr << "Error preparing statement." << endl;
+		exit(1);
+	}
+	sqlite3_stmt * update_variation_units_stmt;
+	rc = sqlite3_prepare(output_db, "UPDATE VARIATION_UNITS SET HASH=? WHERE VARIATION_UNIT=?", -1, & update_variation_units_stmt, 0);
+	if (rc != SQLITE_OK) {
+		cerr << "Error preparing statement." << endl;
+		exit(1);
+	}
+	for (const variation_unit & vu : variation_units) {
+		string vu_id = vu.get_id();
+		unordered_map<string, string> reading_support = vu.get_reading_support();
+		for (const string & wit_id : new_list_wit) {
+			//Skip any witnesses that are lacunose here:
+			if (reading_support.find(wit_id) == reading_support.end()) {
+				continue;
+			}
+			string wit_rdg = reading_support.at(wit_id);
+			sqlite3_bind_int64(insert_into_reading_support_stmt, 1, row_id);
+			sqlite3_bind_text(insert_into_reading_support_stmt, 2, vu_id.c_str(), -1, SQLITE_STATIC);
+			sqlite3_bind_text(insert_into_reading_support_stmt, 3, wit_id.c_str(), -1, SQLITE_STATIC);
+			sqlite3_bind_text(insert_into_reading_support_stmt, 4, wit_rdg.c_str(), -1, SQLITE_STATIC);
+			rc = sqlite3_step(insert_into_reading_support_stmt);
+			if (rc != SQLITE_DONE) {
+				cerr << "Error executing prepared statement." << endl;
+				exit(1);
+			}
+			sqlite3_reset(insert_into_reading_support_stmt);
+			row_id++;
+		}
+		//The unit's hash covers the reading support of the new witnesses as well:
+		string hash = get_variation_unit_hash(vu, list_wit);
+		sqlite3_bind_text(update_variation_units_stmt, 1, hash.c_str(), -1, SQLITE_STATIC);
+		sqlite3_bind_text(update_variation_units_stmt, 2, vu_id.c_str(), -1, SQLITE_STATIC);
+		rc = sqlite3_step(update_variation_units_stmt);
+		if (rc != SQLITE_DONE) {
+			cerr << "Error executing prepared statement." << endl;
+			exit(1);
+		}
+		sqlite3_reset(update_variation_units_stmt);
+	}
+	sqlite3_finalize(insert_into_reading_support_stmt);
+	sqlite3_finalize(update_variation_units_stmt);
+	cout << "Updating table GENEALOGICAL_COMPARISONS..." << endl;
+	comparison_engine engine = comparison_engine(app, classic);
+	vector<comparison_task> tasks = get_comparison_tasks(engine, num_threads, (unsigned int) cached_list_wit.size());
+	//No map of duplicate witnesses is passed, so the comparisons are not deduplicated:
+	calculate_genealogical_comparisons(output_db, engine, list_wit, unordered_map<string, list<string>>(), tasks, get_next_row_id(output_db, "GENEALOGICAL_COMPARISONS"), num_threads, 2 * num_threads, false, max_memory, FULL_SCHEMA);
+	execute_sql(output_db, "END TRANSACTION");
 	return;
 }
 
+/**
+ * Returns true if a table with the given name exists in the given database.
+ */
+bool table_exists(sqlite3 * output_db, const string & table_name) {
+	bool exists = false;
+	sqlite3_stmt * select_from_sqlite_master_stmt;
+	sqlite3_prepare(output_db, "SELECT 1 FROM sqlite_master WHERE type='table' AND name=?", -1, & select_from_sqlite_master_stmt, 0);
+	sqlite3_bind_text(select_from_sqlite_master_stmt, 1, table_name.c_str(), -1, SQLITE_STATIC);
+	if (sqlite3_step(select_from_sqlite_master_stmt) == SQLITE_ROW) {
+		exists = true;
+	}
+	sqlite3_finalize(select_from_sqlite_master_stmt);
+	return exists;
+}
+
+/**
+ * Returns true if the table with the given name in the given database has a column with the given name.
+ */
+bool column_exists(sqlite3 * output_db, const string & table_name, const string & column_name) {
+	bool exists = false;
+	sqlite3_stmt * select_from_table_info_stmt;
+	sqlite3_prepare(output_db, "SELECT 1 FROM pragma_table_info(?) WHERE name=?", -1, & select_from_table_info_stmt, 0);
+	sqlite3_bind_text(select_from_table_info_stmt, 1, table_name.c_str(), -1, SQLITE_STATIC);
+	sqlite3_bind_text(select_from_table_info_stmt, 2, column_name.c_str(), -1, SQLITE_STATIC);
+	if (sqlite3_step(select_from_table_info_stmt) == SQLITE_ROW) {
+		exists = true;
+	}
+	sqlite3_finalize(select_from_table_info_stmt);
+	return exists;
+}
+
+/**
+ * Returns true if the given database holds an interrupted run of populate_db for the given apparatus that can be resumed.
+ * Every run that does not resume another first drops the METADATA and COMPARISON_PROGRESS tables (see discard_interrupted_run()),
+ * and then populates every table but GENEALOGICAL_COMPARISONS before any comparisons are calculated, with the METADATA table last,
+ * so if both it and the COMPARISON_PROGRESS table exist, then only the remaining comparisons need to be calculated.
+ * Exits with an error if the interrupted run was for a different witness list, collation, set of rules, shard, or schema.
+ */
+bool can_resume(sqlite3 * output_db, const apparatus & app, bool classic, const shard_spec & shard, comparison_schema schema) {
+	if (!table_exists(output_db, "METADATA") || !table_exists(output_db, "COMPARISON_PROGRESS")) {
+		cout << "No interrupted run was found in the database, so it will be populated from scratch." << endl;
+		return false;
+	}
+	check_cached_rules(output_db, classic);
+	//The COMPARISON_PROGRESS table is created just after the table of genealogical comparisons, so the latter tells which schema the interrupted run used:
+	if (!table_exists(output_db, get_comparisons_table_name(schema))) {
+		cerr << "Error: the interrupted run stored its genealogical comparisons in a different schema, so it cannot be resumed; please run populate_db with the same --compact or --clustered option as before." << endl;
+		exit(1);
+	}
+	if (!column_exists(output_db, get_comparisons_table_name(schema), "EXTANT_COUNT")) {
+		cerr << "Error: the interrupted run was made by an older version of populate_db that did not store relationship counts, so it cannot be resumed; please run populate_db without the --resume option." << endl;
+		exit(1);
+	}
+	string shard_value = shard.count > 1 ? to_string(shard.index + 1) + "/" + to_string(shard.count) : string();
+	if (get_cached_shard(output_db) != shard_value) {
+		cerr << "Error: the interrupted run was for a different shard, so it cannot be resumed; please run populate_db with the same --shard option as before." << endl;
+		exit(1);
+	}
+	list<string> list_wit = app.get_list_wit();
+	cache_reader reader(output_db);
+	if (reader.get_list_wit() != list_wit) {
+		cerr << "Error: the list of witnesses has changed since the interrupted run, so it cannot be resumed; please run populate_db without the --resume option." << endl;
+		exit(1);
+	}
+	vector<variation_unit> variation_units = app.get_variation_units();
+	vector<string> cached_hashes = read_cached_hashes(output_db, variation_units);
+	for (unsigned int vu_ind = 0; vu_ind < (unsigned int) variation_units.size(); vu_ind++) {
+		if (get_variation_unit_hash(variation_units[vu_ind], list_wit) != cached_hashes[vu_ind]) {
+			cerr << "Error: variation unit " << variation_units[vu_ind].get_id() << " has changed since the interrupted run, so it cannot be resumed; please run populate_db without the --resume option." << endl;
+			exit(1);
+		}
+	}
+	return true;
+}
+
 /**
  * Entry point to the script.
  */
@@ -480,12 +2797,23 @@ int main(int argc, char* argv[]) {
 	list<string> ignored_suffixes = list<string>();
 	bool merge_splits = false;
 	bool classic = false;
+	bool stream = false;
+	bool bulk_load = false;
+	bool update = false;
+	bool add_witnesses = false;
+	bool resume = false;
+	comparison_schema schema = FULL_SCHEMA;
+	shard_spec shard = {0, 1};
+	string stats_json_name = string();
+	string snapshot_name = string();
+	unsigned int num_threads = 0;
+	unsigned long long max_memory = 0;
 	int threshold = 0;
 	string input_xml_name = string();
 	string output_db_name = string();
 	try {
 		cxxopts::Options options("populate_db", "Parse the given collation XML file and populate the genealogical cache in the given SQLite database.");
-		options.custom_help("[-h] [-t threshold] [-z trivial_reading_type_1 -z trivial_reading_type_2 ...] [-Z dropped_reading_type_1 -Z dropped_reading_type_2 ...] [-s ignored_suffix_1 -s ignored_suffix_2 ...] [--merge-splits] [--classic] input_xml output_db");
+		options.custom_help("[-h] [-t threshold] [-z trivial_reading_type_1 -z trivial_reading_type_2 ...] [-Z dropped_reading_type_1 -Z dropped_reading_type_2 ...] [-s ignored_suffix_1 -s ignored_suffix_2 ...] [--merge-splits] [--classic] [--stream] [--bulk-load] [--update] [--add-witnesses] [--resume] [--compact | --clustered] [--shard i/N] [--snapshot snapshot_file] [--stats-json stats_json] [--max-memory megabytes] [-j threads] input_xml output_db");
 		options.positional_help("").show_positional_help();
 		options.add_options("")
 				("h,help", "print this help")
@@ -494,7 +2822,24 @@ int main(int argc, char* argv[]) {
 				("Z", "reading type to drop entirely (this may be used multiple times)", cxxopts::value<vector<string>>())
 				("s", "ignored witness siglum suffixes (e.g., *, T, V, f) to drop entirely (this may be used multiple times)", cxxopts::value<vector<string>>())
 				("merge-splits", "merge split attestations of the same reading", cxxopts::value<bool>())
-				("classic", "calculate explained readings and costs using classic CBGM rules", cxxopts::value<bool>());
+				("classic", "calculate explained readings and costs using classic CBGM rules", cxxopts::value<bool>())
+				("stream", "parse the collation one <app> element at a time instead of loading the whole XML document at once (reduces peak memory usage)", cxxopts::value<bool>())
+				("bulk-load", "build the database in a temporary file with journaling disabled and indexes created after loading, then move it into place (faster for large collations; the output database is replaced entirely)", cxxopts::value<bool>())
+				("update", "update an existing database in place, recalculating only the data for variation units whose local stemmata have changed", cxxopts::value<bool>())
+				("add-witnesses", "add any witnesses in the collation that are not yet in an existing database to it, calculating only their comparisons", cxxopts::value<bool>())
+				("resume", "resume an interrupted run of populate_db on the same collation and database, skipping the comparisons it already committed", cxxopts::value<bool>())
+				("compact", "store each pair of witnesses in a single row containing only the bitmaps that cannot be derived from the others, rather than a row for each direction (roughly halves the size of the database and the time taken to write it)", cxxopts::value<bool>())
+				("clustered", "store the genealogical comparisons in a table keyed by witness ordinals, so that each witness's comparisons are stored contiguously (speeds up reading a witness's comparisons)", cxxopts::value<bool>())
+				("shard", "calculate only the comparisons for shard i of N (counting from 1) of the primary witnesses; the N shard databases can then be combined with merge_db", cxxopts::value<string>())
+				("snapshot", "after populating the database, also write a memory-mappable snapshot of its genealogical cache to the given file, which print_global_stemma and print_textual_flow can load in place of the database", cxxopts::value<string>())
+				("stats-json", "write the wall time, CPU time, rows written, bytes of BLOB data written, and peak memory usage of each phase of the run to the given JSON file", cxxopts::value<string>())
+				("max-memory", "memory budget in megabytes (which may be fractional) for genealogical comparisons waiting to be written; comparisons beyond the budget are spilled to a temporary file, and fewer threads are used if necessary (default: no limit)", cxxopts::value<double>())
+				("j,threads", "number of threads to use for calculating genealogical comparisons (default: number of hardware threads)", cxxopts::value<unsigned int>());
+		#ifdef POPULATE_DB_TESTING
+			//This option is only used by the tests, so it is not listed in the help documentation:
+			options.add_options("testing")
+					("interrupt-after", "exit abruptly after populating the given table or committing the given number of comparison tasks, as if the run had been killed", cxxopts::value<string>());
+		#endif
 		options.add_options("positional")
 				("input_xml", "collation file in TEI XML format", cxxopts::value<string>())
 				("output_db", "output SQLite database (if an existing database is provided, its contents will be overwritten)", cxxopts::value<vector<string>>());
@@ -530,6 +2875,92 @@ int main(int argc, char* argv[]) {
 		if (args.count("classic")) {
 			classic = args["classic"].as<bool>();
 		}
+		if (args.count("stream")) {
+			stream = args["stream"].as<bool>();
+		}
+		if (args.count("bulk-load")) {
+			bulk_load = args["bulk-load"].as<bool>();
+		}
+		if (args.count("update")) {
+			update = args["update"].as<bool>();
+		}
+		if (args.count("add-witnesses")) {
+			add_witnesses = args["add-witnesses"].as<bool>();
+		}
+		if ((update || add_witnesses) && bulk_load) {
+			cerr << "Error: the --bulk-load option cannot be used together with the --update or --add-witnesses options." << endl;
+			exit(1);
+		}
+		if (args.count("resume")) {
+			resume = args["resume"].as<bool>();
+		}
+		if (resume && (bulk_load || update || add_witnesses)) {
+			cerr << "Error: the --resume option cannot be used together with the --bulk-load, --update, or --add-witnesses options." << endl;
+			exit(1);
+		}
+		if (update && add_witnesses) {
+			cerr << "Error: the --update and --add-witnesses options cannot be used together; please run populate_db with each of them in turn." << endl;
+			exit(1);
+		}
+		if (args.count("compact") && args["compact"].as<bool>()) {
+			schema = COMPACT_SCHEMA;
+		}
+		if (args.count("clustered") && args["clustered"].as<bool>()) {
+			if (schema == COMPACT_SCHEMA) {
+				cerr << "Error: the --compact and --clustered options cannot be used together." << endl;
+				exit(1);
+			}
+			schema = CLUSTERED_SCHEMA;
+		}
+		if (schema != FULL_SCHEMA && (update || add_witnesses)) {
+			cerr << "Error: the --compact and --clustered options cannot be used together with the --update or --add-witnesses options." << endl;
+			exit(1);
+		}
+		if (args.count("shard")) {
+			string shard_arg = args["shard"].as<string>();
+			unsigned int shard_num = 0;
+			unsigned int shard_count = 0;
+			char trailing;
+			if (sscanf(shard_arg.c_str(), "%u/%u%c", & shard_num, & shard_count, & trailing) != 2 || shard_num < 1 || shard_num > shard_count) {
+				cerr << "Error: the --shard option must be of the form i/N, where 1 <= i <= N." << endl;
+				exit(1);
+			}
+			shard.index = shard_num - 1;
+			shard.count = shard_count;
+		}
+		if (shard.count > 1 && (update || add_witnesses)) {
+			cerr << "Error: the --shard option cannot be used together with the --update or --add-witnesses options." << endl;
+			exit(1);
+		}
+		if (args.count("snapshot")) {
+			snapshot_name = args["snapshot"].as<string>();
+		}
+		if (shard.count > 1 && !snapshot_name.empty()) {
+			cerr << "Error: the --snapshot option cannot be used together with the --shard option, since a shard database holds only part of the genealogical cache." << endl;
+			exit(1);
+		}
+		if (args.count("stats-json")) {
+			stats_json_name = args["stats-json"].as<string>();
+		}
+		if (args.count("max-memory")) {
+			max_memory = (unsigned long long) (args["max-memory"].as<double>() * 1024 * 1024);
+			if (max_memory == 0) {
+				cerr << "Error: the memory budget must be at least 1 byte." << endl;
+				exit(1);
+			}
+		}
+		#ifdef POPULATE_DB_TESTING
+			if (args.count("interrupt-after")) {
+				interrupt_checkpoint = args["interrupt-after"].as<string>();
+			}
+		#endif
+		if (args.count("threads")) {
+			num_threads = args["threads"].as<unsigned int>();
+			if (num_threads == 0) {
+				cerr << "Error: the number of threads must be at least 1." << endl;
+				exit(1);
+			}
+		}
 		//Parse the positional arguments:
 		if (!args.count("input_xml") || args.count("output_db") != 1) {
 			cerr << "Error: 2 positional arguments (input_xml and output_db) are required." << endl;
@@ -544,100 +2975,208 @@ int main(int argc, char* argv[]) {
 		cerr << "Error parsing options: " << e.what() << endl;
 		exit(-1);
 	}
-	//Attempt to parse the input XML file as an apparatus:
-	xml_document doc;
-	xml_parse_result pr = doc.load_file(input_xml_name.c_str());
-	if (!pr) {
-		cerr << "Error: An error occurred while loading XML file " << input_xml_name << ": " << pr.description() << endl;
-		exit(1);
-	}
-	xml_node tei_node = doc.child("TEI");
-	if (!tei_node) {
-		cerr << "Error: The XML file " << input_xml_name << " does not have a <TEI> element as its root element." << endl;
-		exit(1);
-	}
-	apparatus app = apparatus(tei_node, merge_splits, trivial_reading_types, dropped_reading_types, ignored_suffixes);
+	//Record the resource usage of each phase of the run:
+	stats_report stats = stats_report();
+	//Parse the input XML file as an apparatus:
+	apparatus app = stream ? stream_apparatus(input_xml_name, merge_splits, trivial_reading_types, dropped_reading_types, ignored_suffixes, stats) : load_apparatus(input_xml_name, merge_splits, trivial_reading_types, dropped_reading_types, ignored_suffixes, stats);
+	print_peak_memory_usage("Peak memory usage after parsing: ");
+	//Count the variation units at which each witness is extant:
+	stats.begin_phase("extant_counting");
+	unordered_map<string, int> extant_counts = get_extant_counts(app);
+	stats.end_phase();
 	//If the user has specified a minimum extant readings threshold,
 	//then repopulate the apparatus's witness list with just the IDs of witnesses that meet the threshold:
 	if (threshold > 0) {
 		cout << "Filtering out fragmentary witnesses... " << endl;
+		stats.begin_phase("threshold_filter");
 		list<string> list_wit = app.get_list_wit();
 		list_wit.remove_if([&](const string & wit_id) {
-			return app.get_extant_passages_for_witness(wit_id) < threshold;
+			return extant_counts.at(wit_id) < threshold;
 		});
 		app.set_list_wit(list_wit);
+		stats.end_phase();
+	}
+	list<string> list_wit = app.get_list_wit();
+	if (num_threads == 0) {
+		num_threads = std::max(1u, static_cast<unsigned int>(std::thread::hardware_concurrency()));
+	}
+	//If an existing database is to be updated, then open it (without creating it if it does not exist) and update it:
+	if (update || add_witnesses) {
+		cout << "Opening database..." << endl;
+		sqlite3 * output_db;
+		int rc = sqlite3_open_v2(output_db_name.c_str(), & output_db, SQLITE_OPEN_READWRITE, NULL);
+		if (rc) {
+			cerr << "Error opening database " << output_db_name << ": " << sqlite3_errmsg(output_db) << endl;
+			exit(1);
+		}
+		if (table_exists(output_db, get_comparisons_table_name(COMPACT_SCHEMA)) || table_exists(output_db, get_comparisons_table_name(CLUSTERED_SCHEMA))) {
+			cerr << "Error: the database was populated with the --compact or --clustered option, which does not support updating or adding witnesses; please repopulate it." << endl;
+			exit(1);
+		}
+		if (!column_exists(output_db, "GENEALOGICAL_COMPARISONS", "EXTANT_COUNT")) {
+			cerr << "Error: the database's GENEALOGICAL_COMPARISONS table has no relationship count columns, so it was populated by an older version of populate_db and cannot be updated; please repopulate it." << endl;
+			exit(1);
+		}
+		auto update_start = chrono::high_resolution_clock::now();
+		if (update) {
+			stats.begin_phase("update_genealogical_cache", output_db);
+			update_genealogical_cache(output_db, app, classic);
+		}
+		else {
+			stats.begin_phase("add_witnesses_to_cache", output_db);
+			add_witnesses_to_cache(output_db, app, extant_counts, classic, num_threads, max_memory);
+		}
+		increment_cache_generation(output_db);
+		stats.end_phase();
+		print_elapsed_time("Time taken to update database: ", update_start);
+		if (!snapshot_name.empty()) {
+			cout << "Writing snapshot..." << endl;
+			stats.begin_phase("write_snapshot");
+			write_cache_snapshot(output_db, snapshot_name);
+			stats.end_phase();
+		}
+		cout << "Closing database..." << endl;
+		sqlite3_close(output_db);
+		cout << "Database closed." << endl;
+		print_peak_memory_usage("Peak memory usage: ");
+		if (!stats_json_name.empty()) {
+			stats.write_json(stats_json_name, input_xml_name, output_db_name, num_threads);
+		}
+		exit(0);
+	}
+	//Now open the output database.
+	//In bulk-load mode, the database is built from scratch in a temporary file and only moved into place once it is complete:
+	string db_name = bulk_load ? output_db_name + ".tmp" : output_db_name;
+	if (bulk_load) {
+		remove(db_name.c_str());
 	}
-	
-	
-//Then initialize all of these witnesses:
-cout << "Initializing all witnesses (this may take a while)... " << endl;
-list<string> list_wit = app.get_list_wit();
-vector<thread> threads;
-mutex mtx;
-
-list<witness> witnesses;
-
-unsigned int num_threads = std::min(static_cast<unsigned int>(std::thread::hardware_concurrency()), static_cast<unsigned int>(list_wit.size()));
-
-auto it = list_wit.begin();
-auto start = std::chrono::high_resolution_clock::now();
-for (unsigned int i = 0; i < num_threads; ++i) {
-    threads.push_back(thread([&]() {
-        for (; it != list_wit.end(); ) {
-            string wit_id;
-            {
-                lock_guard<mutex> lock(mtx);
-                if (it == list_wit.end()) {
-                    break;
-                }
-                wit_id = *it;
-                ++it;
-            }
-			stringstream msg;
-            msg << "Calculating coherence for witness " << wit_id << "..." << endl;
-			cout << msg.str();
-            witness wit(wit_id, app, classic);
-            {
-                lock_guard<mutex> lock(mtx);
-                witnesses.push_back(wit);
-            }
-        }
-    }));
-}
-for (auto &t : threads) {
-    t.join();
-}
-auto end = chrono::high_resolution_clock::now();
-chrono::duration<double> diff = end-start;
-long long total_seconds = chrono::duration_cast<chrono::seconds>(diff).count();
-long long hours = total_seconds / 3600;
-long long minutes = (total_seconds % 3600) / 60;
-long long seconds = total_seconds % 60;
-cout << "Time taken: " << hours << " hours " << minutes << " minutes " << seconds << " seconds" << endl;
-	//Now open the output database:
 	cout << "Opening database..." << endl;
 	sqlite3 * output_db;
-	int rc = sqlite3_open(output_db_name.c_str(), & output_db);
+	int rc = sqlite3_open(db_name.c_str(), & output_db);
 	if (rc) {
-		cerr << "Error opening database " << output_db_name << ": " << sqlite3_errmsg(output_db) << endl;
-		exit(1);
-	}
-	//Populate each table:
-	cout << "Populating table READINGS..." << endl;
-	populate_readings_table(output_db, app);
-	cout << "Populating table READING_RELATIONS..." << endl;
-	populate_reading_relations_table(output_db, app);
-	cout << "Populating table READING_SUPPORT..." << endl;
-	populate_reading_support_table(output_db, app);
-	cout << "Populating table VARIATION_UNITS..." << endl;
-	populate_variation_units_table(output_db, app);
-	cout << "Populating table GENEALOGICAL_COMPARISONS..." << endl;
-	populate_genealogical_comparisons_table(output_db, witnesses);
-	cout << "Populating table WITNESSES..." << endl;
-	populate_witnesses_table(output_db, list_wit);
+		cerr << "Error opening database " << db_name << ": " << sqlite3_errmsg(output_db) << endl;
+		exit(1);
+	}
+	if (bulk_load) {
+		configure_bulk_load(output_db);
+	}
+	//If an interrupted run is to be resumed, then check that it can be:
+	bool resuming = resume && can_resume(output_db, app, classic, shard, schema);
+	//Intern the witnesses and readings of the apparatus in a comparison engine, whose reading matrix is shared by the READING_SUPPORT table and the comparisons:
+	stats.begin_phase("comparison_engine_construction");
+	comparison_engine engine = comparison_engine(app, classic);
+	stats.end_phase();
+	//Populate each table but GENEALOGICAL_COMPARISONS, unless this was already done by the interrupted run.
+	//The METADATA table is populated last, since its presence indicates that the others are complete;
+	//for this to hold, any METADATA table left by a previous run is dropped before the others are touched:
+	if (!resuming) {
+		discard_interrupted_run(output_db);
+		cout << "Populating table READINGS..." << endl;
+		auto table_start = chrono::high_resolution_clock::now();
+		stats.begin_phase("populate_readings_table", output_db);
+		populate_readings_table(output_db, app, bulk_load);
+		stats.end_phase();
+		print_elapsed_time("Time taken to populate table READINGS: ", table_start);
+		check_interrupt("READINGS");
+		cout << "Populating table READING_RELATIONS..." << endl;
+		table_start = chrono::high_resolution_clock::now();
+		stats.begin_phase("populate_reading_relations_table", output_db);
+		populate_reading_relations_table(output_db, app, bulk_load);
+		stats.end_phase();
+		print_elapsed_time("Time taken to populate table READING_RELATIONS: ", table_start);
+		check_interrupt("READING_RELATIONS");
+		cout << "Populating table READING_SUPPORT..." << endl;
+		table_start = chrono::high_resolution_clock::now();
+		stats.begin_phase("populate_reading_support_table", output_db);
+		populate_reading_support_table(output_db, engine, bulk_load);
+		stats.end_phase();
+		print_elapsed_time("Time taken to populate table READING_SUPPORT: ", table_start);
+		check_interrupt("READING_SUPPORT");
+		cout << "Populating table VARIATION_UNITS..." << endl;
+		table_start = chrono::high_resolution_clock::now();
+		stats.begin_phase("populate_variation_units_table", output_db);
+		populate_variation_units_table(output_db, app, bulk_load);
+		stats.end_phase();
+		print_elapsed_time("Time taken to populate table VARIATION_UNITS: ", table_start);
+		check_interrupt("VARIATION_UNITS");
+		cout << "Populating table WITNESSES..." << endl;
+		table_start = chrono::high_resolution_clock::now();
+		stats.begin_phase("populate_witnesses_table", output_db);
+		populate_witnesses_table(output_db, list_wit, extant_counts, bulk_load);
+		stats.end_phase();
+		print_elapsed_time("Time taken to populate table WITNESSES: ", table_start);
+		check_interrupt("WITNESSES");
+		cout << "Populating table METADATA..." << endl;
+		stats.begin_phase("populate_metadata_table", output_db);
+		populate_metadata_table(output_db, classic, shard);
+		stats.end_phase();
+		check_interrupt("METADATA");
+	}
+	//Then calculate the genealogical comparisons between all pairs of witnesses (or just those in this shard) and write them to the database as they are completed:
+	if (shard.count > 1) {
+		cout << "Calculating shard " << shard.index + 1 << " of " << shard.count << "..." << endl;
+	}
+	cout << "Populating table GENEALOGICAL_COMPARISONS (this may take a while)..." << endl;
+	//Witnesses with identical readings everywhere have identical comparisons, so only the first witness of each such group needs to be compared:
+	stats.begin_phase("witness_deduplication");
+	unordered_map<string, list<string>> duplicates = get_duplicate_witnesses(engine);
+	const comparison_engine * distinct_engine = & engine;
+	comparison_engine deduplicated_engine = comparison_engine();
+	if (!duplicates.empty()) {
+		set<string> duplicate_wits = set<string>();
+		for (const pair<const string, list<string>> & kv : duplicates) {
+			duplicate_wits.insert(kv.second.begin(), kv.second.end());
+		}
+		cout << "Collapsed " << duplicate_wits.size() << " witnesses with identical readings into " << duplicates.size() << " groups; their comparisons will be copied from those of the first witness in each group." << endl;
+		vector<unsigned int> distinct_wit_inds = vector<unsigned int>();
+		unsigned int wit_ind = 0;
+		for (const string & wit_id : list_wit) {
+			if (duplicate_wits.find(wit_id) == duplicate_wits.end()) {
+				distinct_wit_inds.push_back(wit_ind);
+			}
+			wit_ind++;
+		}
+		deduplicated_engine = comparison_engine(engine, distinct_wit_inds);
+		distinct_engine = & deduplicated_engine;
+	}
+	stats.end_phase();
+	unsigned int queue_depth = 2 * num_threads;
+	auto start = chrono::high_resolution_clock::now();
+	stats.begin_phase("populate_genealogical_comparisons_table", output_db);
+	unsigned long long blob_bytes = populate_genealogical_comparisons_table(output_db, * distinct_engine, list_wit, duplicates, num_threads, queue_depth, bulk_load, resuming, shard, max_memory, schema);
+	stats.end_phase((long long) blob_bytes);
+	auto end = chrono::high_resolution_clock::now();
+	chrono::duration<double> diff = end - start;
+	long long total_seconds = chrono::duration_cast<chrono::seconds>(diff).count();
+	long long hours = total_seconds / 3600;
+	long long minutes = (total_seconds % 3600) / 60;
+	long long seconds = total_seconds % 60;
+	cout << "Time taken: " << hours << " hours " << minutes << " minutes " << seconds << " seconds" << endl;
+	print_peak_memory_usage("Peak memory usage after calculating coherence: ");
+	if (bulk_load) {
+		stats.begin_phase("create_deferred_indexes", output_db);
+		create_deferred_indexes(output_db, schema);
+		stats.end_phase();
+	}
+	if (!snapshot_name.empty()) {
+		cout << "Writing snapshot..." << endl;
+		stats.begin_phase("write_snapshot");
+		write_cache_snapshot(output_db, snapshot_name);
+		stats.end_phase();
+	}
 	//Finally, close the output database:
 	cout << "Closing database..." << endl;
 	sqlite3_close(output_db);
 	cout << "Database closed." << endl;
+	if (bulk_load) {
+		if (!replace_file(db_name, output_db_name)) {
+			cerr << "Error moving database " << db_name << " to " << output_db_name << "." << endl;
+			exit(1);
+		}
+	}
+	print_peak_memory_usage("Peak memory usage: ");
+	if (!stats_json_name.empty()) {
+		stats.write_json(stats_json_name, input_xml_name, output_db_name, num_threads);
+	}
 	exit(0);
 }
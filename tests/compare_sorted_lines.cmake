@@ -0,0 +1,10 @@
+# Compares the files FILE_1 and FILE_2 line by line, ignoring the order of their lines, and fails if they differ.
+# This is used to compare tables whose rows follow a cache's witness list, whose order depends on how the cache was populated.
+# Usage: cmake -DFILE_1=<file> -DFILE_2=<file> -P compare_sorted_lines.cmake
+file(STRINGS "${FILE_1}" lines_1)
+file(STRINGS "${FILE_2}" lines_2)
+list(SORT lines_1)
+list(SORT lines_2)
+if (NOT "${lines_1}" STREQUAL "${lines_2}")
+  message(FATAL_ERROR "The lines of ${FILE_1} and ${FILE_2} differ.")
+endif()
@@ -0,0 +1,16 @@
+# Writes a copy of the collation INPUT to OUTPUT with the direction of the first <arc> element reversed,
+# so that the local stemma of one variation unit differs from that of the original collation.
+# This is used to test updating a genealogical cache with populate_db --update.
+# Usage: cmake -DINPUT=<collation> -DOUTPUT=<changed collation> -P reverse_first_arc.cmake
+file(READ "${INPUT}" xml)
+string(REGEX MATCH "<arc from=\"[^\"]*\" to=\"[^\"]*\"" arc "${xml}")
+if (NOT arc)
+  message(FATAL_ERROR "No <arc> element was found in ${INPUT}.")
+endif()
+string(REGEX REPLACE "<arc from=\"([^\"]*)\" to=\"([^\"]*)\"" "<arc from=\"\\2\" to=\"\\1\"" reversed_arc "${arc}")
+string(FIND "${xml}" "${arc}" arc_begin)
+string(LENGTH "${arc}" arc_length)
+math(EXPR arc_end "${arc_begin} + ${arc_length}")
+string(SUBSTRING "${xml}" 0 ${arc_begin} xml_before)
+string(SUBSTRING "${xml}" ${arc_end} -1 xml_after)
+file(WRITE "${OUTPUT}" "${xml_before}${reversed_arc}${xml_after}")